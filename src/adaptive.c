@@ -0,0 +1,197 @@
+/* Self-adaptive variation operators. Each island keeps a probability for every operator of three classes: crossover (none, two point, uniform), mutation (none, bit flip, swap) and mutation strength (number of deletion sites mutated). Offspring record the operators that created them, and after environmental selection the survival rate of the offspring of each operator updates its quality and its probability by adaptive pursuit (Thierens, 2005).
+ * Notes:
+ *      - Not applying crossover or mutation are operators of their own class, so crossover_probability and mutation_probability only set the initial probabilities.
+ *      - The initial probabilities of applying crossover and mutation are exactly crossover_probability and mutation_probability. From the first update every operator keeps a probability of at least ADAPT_P_MIN, so it can be picked again if it becomes useful later in the run.
+ *      - Offspring identical to one of their parents are never credited, otherwise operators that create clones of good parents (e.g., no crossover and no mutation) would look successful.
+ *      - Only deletions are mutated by the adaptive operators, module reactions are mutated as in mutation().
+ */
+
+#include <stdlib.h>
+#include "modcell.h"
+
+#define N_OPS 3 		/* Operators per class */
+#define N_CLASSES 3
+#define CLASS_CROSSOVER 0
+#define CLASS_MUTATION 1
+#define CLASS_STRENGTH 2
+#define ADAPT_P_MIN 0.05 	/* Minimum probability of an operator */
+#define ADAPT_ALPHA 0.1 	/* Quality adaptation rate */
+#define ADAPT_BETA 0.1 		/* Probability adaptation rate */
+
+extern int mpi_pe;
+
+void adaptive_init(MCproblem *mcp);
+void adaptive_variation(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng);
+void adaptive_update(MCproblem *mcp, Population *offspring_pop, Population *parent_pop);
+void adaptive_print(MCproblem *mcp);
+void adaptive_checkpoint(FILE *f, int restore);
+static int select_operator(int c, pcg32_random_t *rng);
+static void adaptive_mutation(MCproblem *mcp, Individual *indv, int op, int strength, pcg32_random_t *rng);
+static void set_initial(int c, double p_op);
+static void count_operators(int operators, int counts[N_CLASSES][N_OPS]);
+
+/* Globals */
+static const int strengths[N_OPS] = {1, 2, 4};
+static double probability[N_CLASSES][N_OPS];
+static double quality[N_CLASSES][N_OPS];
+
+/* Operators are stored in Individual.operators as ((crossover*N_OPS) + mutation)*N_OPS + strength, plus CLONE_OFFSET for clones */
+#define CLONE_OFFSET (N_OPS*N_OPS*N_OPS)
+#define GET_OPERATOR(operators, c) (((operators) / (c == CLASS_CROSSOVER ? N_OPS*N_OPS : (c == CLASS_MUTATION ? N_OPS : 1))) % N_OPS)
+
+void
+adaptive_init(MCproblem *mcp)
+{
+    set_initial(CLASS_CROSSOVER, mcp->crossover_probability);
+    set_initial(CLASS_MUTATION, mcp->mutation_probability);
+    for (int i=0; i < N_OPS; i++) /* Start from the single site mutation of mutation() */
+        probability[CLASS_STRENGTH][i] = (i == 0) ? 1 - (N_OPS-1)*ADAPT_P_MIN : ADAPT_P_MIN;
+    for (int c=0; c < N_CLASSES; c++)
+        for (int i=0; i < N_OPS; i++)
+            quality[c][i] = 0;
+}
+
+/* Operator 0 (none) takes 1 - p_op and the other two share p_op: the alternative one takes the minimum and the default operator (1) the rest. Below twice the minimum p_op is split evenly, so the initial rate is p_op and the minimum only applies from the first update. */
+static void
+set_initial(int c, double p_op)
+{
+    if (p_op > 1 - ADAPT_P_MIN)
+        p_op = 1 - ADAPT_P_MIN;
+    if (p_op < 0)
+        p_op = 0;
+    probability[c][2] = (p_op < 2*ADAPT_P_MIN) ? p_op / 2 : ADAPT_P_MIN;
+    probability[c][1] = p_op - probability[c][2];
+    probability[c][0] = 1 - p_op;
+}
+
+static int
+select_operator(int c, pcg32_random_t *rng)
+{
+    double r = (double)pcg32_random_r(rng) / 4294967296.0, cumulative = 0;
+
+    for (int i=0; i < N_OPS - 1; i++) {
+        cumulative += probability[c][i];
+        if (r < cumulative)
+            return i;
+    }
+    return N_OPS - 1;
+}
+
+/* Replaces crossover() and mutation(), children are tagged with the operators used */
+void
+adaptive_variation(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng)
+{
+    int op_crossover, op_mutation, op_strength;
+
+    op_crossover = select_operator(CLASS_CROSSOVER, rng);
+    if (op_crossover == 1) {
+        crossover_two_point(mcp, parent1, parent2, child1, child2, rng);
+    }
+    else if (op_crossover == 2) {
+        crossover_uniform(mcp, parent1, parent2, child1, child2, rng);
+    }
+    else {
+        copy_individual(mcp, parent1, child1);
+        copy_individual(mcp, parent2, child2);
+    }
+
+    op_mutation = select_operator(CLASS_MUTATION, rng);
+    op_strength = select_operator(CLASS_STRENGTH, rng);
+    adaptive_mutation(mcp, child1, op_mutation, strengths[op_strength], rng);
+    child1->operators = (op_crossover*N_OPS + op_mutation)*N_OPS + op_strength;
+    if (is_same_genome(mcp, child1, parent1) || is_same_genome(mcp, child1, parent2))
+        child1->operators += CLONE_OFFSET;
+
+    op_mutation = select_operator(CLASS_MUTATION, rng);
+    op_strength = select_operator(CLASS_STRENGTH, rng);
+    adaptive_mutation(mcp, child2, op_mutation, strengths[op_strength], rng);
+    child2->operators = (op_crossover*N_OPS + op_mutation)*N_OPS + op_strength;
+    if (is_same_genome(mcp, child2, parent1) || is_same_genome(mcp, child2, parent2))
+        child2->operators += CLONE_OFFSET;
+}
+
+static void
+adaptive_mutation(MCproblem *mcp, Individual *indv, int op, int strength, pcg32_random_t *rng)
+{
+    int i, k, site;
+
+    for (i=0; (op != 0) && (i < strength); i++) {
+        if (op == 1) {
+            site = mcp->guided_mutation ? gene_model_site(mcp, rng) : pcg32_boundedrand_r(rng, mcp->n_vars);
+            indv->deletions[site] = !indv->deletions[site];
+        }
+        else {
+            mutation_swap(mcp, indv, rng);
+        }
+    }
+
+    if (mcp->use_modules) {
+        for (k=0; k < mcp->n_models; k++) {
+            if ( (double)pcg32_boundedrand_r(rng, 100)/100 <= mcp->mutation_probability)  {
+                site = pcg32_boundedrand_r(rng, mcp->n_vars);
+                indv->modules[k*mcp->n_vars + site] = !indv->modules[k*mcp->n_vars + site];
+            }
+        }
+    }
+}
+
+/* Credits the operators of the offspring that survived environmental selection and clears the operators of the parent population, so only offspring of the next generation are credited */
+void
+adaptive_update(MCproblem *mcp, Population *offspring_pop, Population *parent_pop)
+{
+    int c, i, best, used[N_CLASSES][N_OPS] = {{0}}, survived[N_CLASSES][N_OPS] = {{0}};
+    double p_max = 1 - (N_OPS-1)*ADAPT_P_MIN, target;
+
+    for (i=0; i < offspring_pop->size; i++)
+        if (offspring_pop->indv[i].operators != NO_OPERATORS)
+            count_operators(offspring_pop->indv[i].operators % CLONE_OFFSET, used);
+    for (i=0; i < parent_pop->size; i++) {
+        if (parent_pop->indv[i].operators != NO_OPERATORS) {
+            if (parent_pop->indv[i].operators < CLONE_OFFSET)
+                count_operators(parent_pop->indv[i].operators, survived);
+            parent_pop->indv[i].operators = NO_OPERATORS;
+        }
+    }
+
+    for (c=0; c < N_CLASSES; c++) {
+        best = 0;
+        for (i=0; i < N_OPS; i++) {
+            if (used[c][i] > 0)
+                quality[c][i] += ADAPT_ALPHA * ((double)survived[c][i]/used[c][i] - quality[c][i]);
+            if (quality[c][i] > quality[c][best])
+                best = i;
+        }
+        for (i=0; i < N_OPS; i++) {
+            target = (i == best) ? p_max : ADAPT_P_MIN;
+            probability[c][i] += ADAPT_BETA * (target - probability[c][i]);
+        }
+    }
+}
+
+/* The strength is not counted if there was no mutation */
+static void
+count_operators(int operators, int counts[N_CLASSES][N_OPS])
+{
+    counts[CLASS_CROSSOVER][GET_OPERATOR(operators, CLASS_CROSSOVER)]++;
+    counts[CLASS_MUTATION][GET_OPERATOR(operators, CLASS_MUTATION)]++;
+    if (GET_OPERATOR(operators, CLASS_MUTATION) != 0)
+        counts[CLASS_STRENGTH][GET_OPERATOR(operators, CLASS_STRENGTH)]++;
+}
+
+void
+adaptive_print(MCproblem *mcp)
+{
+    printf("PE: %i\t Operator probabilities, crossover (none/two point/uniform): %.2f/%.2f/%.2f mutation (none/flip/swap): %.2f/%.2f/%.2f sites (%i/%i/%i): %.2f/%.2f/%.2f\n", mpi_pe,
+            probability[CLASS_CROSSOVER][0], probability[CLASS_CROSSOVER][1], probability[CLASS_CROSSOVER][2],
+            probability[CLASS_MUTATION][0], probability[CLASS_MUTATION][1], probability[CLASS_MUTATION][2],
+            strengths[0], strengths[1], strengths[2],
+            probability[CLASS_STRENGTH][0], probability[CLASS_STRENGTH][1], probability[CLASS_STRENGTH][2]);
+}
+
+/* Saves or restores the operator probabilities and qualities (see checkpoint.c) */
+void
+adaptive_checkpoint(FILE *f, int restore)
+{
+    checkpoint_io(probability, sizeof probability, f, restore);
+    checkpoint_io(quality, sizeof quality, f, restore);
+}
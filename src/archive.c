@@ -0,0 +1,147 @@
+/* Epsilon-dominance archive (Laumanns et al., 2002). The objective space is divided in boxes of side OBJ_TOL and the archive keeps at most one individual per box, only for boxes that are not dominated by the box of another archive member. Objectives closer than OBJ_TOL are not considered different downstream, so this bounds the archive size without losing distinguishable designs.
+ * Notes:
+ *      - Archive decisions use penalty_objectives, as the MOEA does.
+ *      - Within a box, an individual that dominates the current member replaces it, otherwise the one closest to the upper corner of the box is kept.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "modcell.h"
+
+#define ARCHIVE_INITIAL_CAPACITY 64
+
+void archive_init(MCproblem *mcp);
+void archive_free(MCproblem *mcp);
+int archive_offer(MCproblem *mcp, Individual *indv);
+Population * archive_population(void);
+static void set_box(MCproblem *mcp, Individual *indv, long *box);
+static int box_domination(MCproblem *mcp, long *box_a, long *box_b);
+static double corner_distance(MCproblem *mcp, Individual *indv, long *box);
+static void remove_member(MCproblem *mcp, size_t i);
+
+/* Globals */
+static Population archive; 	/* archive.size is the number of members */
+static size_t capacity;
+static long *boxes; 		/* [capacity*n_models] */
+static long *new_box; 		/* [n_models] */
+
+void
+archive_init(MCproblem *mcp)
+{
+    capacity = ARCHIVE_INITIAL_CAPACITY;
+    allocate_population(mcp, &archive, capacity);
+    archive.size = 0;
+    SAFE_ALLOC(boxes = malloc(capacity * mcp->n_models * sizeof *boxes))
+    SAFE_ALLOC(new_box = malloc(mcp->n_models * sizeof *new_box))
+}
+
+void
+archive_free(MCproblem *mcp)
+{
+    archive.size = capacity;
+    free_population(mcp, &archive);
+    free(boxes);
+    free(new_box);
+}
+
+Population *
+archive_population(void)
+{
+    return &archive;
+}
+
+/* Offers an evaluated individual to the archive, returns 1 if it was added */
+int
+archive_offer(MCproblem *mcp, Individual *indv)
+{
+    size_t i;
+    int k, f;
+
+    set_box(mcp, indv, new_box);
+
+    for (i=0; i < archive.size; i++) {
+        f = box_domination(mcp, &(boxes[i*mcp->n_models]), new_box);
+        if (f == A_DOMINATES_B)
+            return 0;
+        if (f == 2) { /* Same box */
+            f = find_domination(mcp, &(archive.indv[i]), indv);
+            if ((f == A_DOMINATES_B) || ((f == NONDOMINATED) &&
+                        (corner_distance(mcp, &(archive.indv[i]), new_box) <= corner_distance(mcp, indv, new_box))))
+                return 0;
+            copy_individual(mcp, indv, &(archive.indv[i])); /* A single box member exists, so nothing else can be dominated */
+            return 1;
+        }
+    }
+
+    /* Remove members in dominated boxes */
+    for (i=0; i < archive.size; ) {
+        if (box_domination(mcp, new_box, &(boxes[i*mcp->n_models])) == A_DOMINATES_B)
+            remove_member(mcp, i);
+        else
+            i++;
+    }
+
+    if (archive.size == capacity) {
+        capacity *= 2;
+        SAFE_ALLOC(archive.indv = realloc(archive.indv, capacity * sizeof *archive.indv))
+        for (i=archive.size; i < capacity; i++)
+            allocate_individual(mcp, &(archive.indv[i]));
+        SAFE_ALLOC(boxes = realloc(boxes, capacity * mcp->n_models * sizeof *boxes))
+    }
+    copy_individual(mcp, indv, &(archive.indv[archive.size]));
+    for (k=0; k < mcp->n_models; k++)
+        boxes[archive.size*mcp->n_models + k] = new_box[k];
+    archive.size++;
+    return 1;
+}
+
+static void
+set_box(MCproblem *mcp, Individual *indv, long *box)
+{
+    for (int k=0; k < mcp->n_models; k++)
+        box[k] = (long)floor(indv->penalty_objectives[k] / OBJ_TOL);
+}
+
+/* Same return values as find_domination() and 2 if both boxes are the same */
+static int
+box_domination(MCproblem *mcp, long *box_a, long *box_b)
+{
+    int a_dominates_b = 1, b_dominates_a = 1;
+
+    for (int k=0; k < mcp->n_models; k++) {
+        if (box_a[k] > box_b[k])
+            b_dominates_a = 0;
+        if (box_b[k] > box_a[k])
+            a_dominates_b = 0;
+    }
+    if (a_dominates_b && b_dominates_a) return 2;
+    if (a_dominates_b) return A_DOMINATES_B;
+    if (b_dominates_a) return B_DOMINATES_A;
+    return NONDOMINATED;
+}
+
+static double
+corner_distance(MCproblem *mcp, Individual *indv, long *box)
+{
+    double d = 0, v;
+    for (int k=0; k < mcp->n_models; k++) {
+        v = (box[k] + 1)*OBJ_TOL - indv->penalty_objectives[k];
+        d += v*v;
+    }
+    return sqrt(d);
+}
+
+/* The last member takes the place of the removed one, individuals are swapped to avoid copying */
+static void
+remove_member(MCproblem *mcp, size_t i)
+{
+    Individual tmp;
+    size_t last = archive.size - 1;
+
+    tmp = archive.indv[i];
+    archive.indv[i] = archive.indv[last];
+    archive.indv[last] = tmp;
+    for (int k=0; k < mcp->n_models; k++)
+        boxes[i*mcp->n_models + k] = boxes[last*mcp->n_models + k];
+    archive.size--;
+}
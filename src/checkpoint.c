@@ -0,0 +1,271 @@
+/* Checkpoint/restart of the island state (NSGA-II engine), so a run killed by a batch system can continue with --resume instead of starting over.
+ * Notes:
+ *      - Every checkpoint_interval seconds each island writes its state to OUTPUT_FILE_<PE>.ckpt<epoch % 2>: the parent population with objectives, penalty objectives, ranks and crowding distances, the generation counter, the run time, the round of the variation RNG streams and the global RNG state, the deletion blacklist, and, if used, the adaptive operator probabilities, the migration schedule, the topology stall counters and the individuals to be replaced by migrants. The file is written under a temporary name, synced and renamed, so a file is always complete.
+ *      - Epochs are coordinated through a non-blocking barrier on checkpoint_comm: an island only starts epoch e+1 once all islands have written epoch e, so islands are at most one epoch apart and the two files of each island always hold the last epoch written by all islands. --resume loads that epoch in all islands.
+ *      - SIGUSR1 requests a checkpoint as soon as possible, SIGTERM a checkpoint followed by the normal end of the run (population files are written). Batch systems signal all ranks, a signal sent to a single rank may only be honoured at the next checkpoint of the others.
+ *      - The final state is written at the end of the run too, so a finished run can be extended with --resume and larger limits.
+ *      - Migrants in transit (messages or mailboxes) are not saved, they are copies of individuals of other islands. Auxiliary state that is rebuilt from the population (epsilon archive, gene model, surrogate model) or restarted (metrics and stall detection history, global archive, fitness cache) is not saved either.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "modcell.h"
+
+#define CHECKPOINT_MAGIC "MCCKPT1"
+
+extern int mpi_pe, mpi_comm_size;
+extern unsigned int variation_round;
+
+typedef struct {
+	char magic[8];
+	unsigned int epoch;
+	int comm_size;
+	size_t n_vars;
+	unsigned int n_models;
+	unsigned int population_size;
+	unsigned int migration_size;
+	int use_modules;
+	int adaptive_operators;
+} CheckpointHeader;
+
+void checkpoint_init(MCproblem *mcp);
+int checkpoint_poll(MCproblem *mcp, Population *parent_population, int *receive_idx, unsigned int n_generations, double run_time);
+void checkpoint_finalize(MCproblem *mcp, Population *parent_population, int *receive_idx, unsigned int n_generations, double run_time);
+void checkpoint_load(MCproblem *mcp, Population *parent_population, unsigned int *n_generations, double *run_time);
+void checkpoint_restore_state(MCproblem *mcp, Population *parent_population, int *receive_idx);
+void checkpoint_io(void *data, size_t size, FILE *f, int restore);
+static void write_checkpoint(MCproblem *mcp, Population *parent_population, int *receive_idx, unsigned int n_generations, double run_time);
+static void core_io(MCproblem *mcp, FILE *f, int restore, Population *pop, unsigned int *n_generations, double *run_time);
+static void state_io(MCproblem *mcp, FILE *f, int restore, int *receive_idx);
+static void set_header(MCproblem *mcp, CheckpointHeader *header, unsigned int header_epoch);
+static unsigned int read_header(MCproblem *mcp, FILE *f);
+static void handle_signal(int sig);
+
+/* Globals */
+static MPI_Comm checkpoint_comm;
+static MPI_Request epoch_request; 	/* Barrier of the last epoch written by this island */
+static unsigned int epoch; 		/* Last epoch written (or loaded) */
+static double last_time;
+static volatile sig_atomic_t signal_received; /* 0, SIGUSR1 or SIGTERM */
+static FILE *resume_fp; 		/* Between checkpoint_load() and checkpoint_restore_state() */
+
+/* Collective */
+void
+checkpoint_init(MCproblem *mcp)
+{
+    struct sigaction action;
+
+    MPI_Comm_dup(MPI_COMM_WORLD, &checkpoint_comm);
+    epoch_request = MPI_REQUEST_NULL;
+    last_time = MPI_Wtime();
+    signal_received = 0;
+
+    memset(&action, 0, sizeof action);
+    action.sa_handler = handle_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGUSR1, &action, NULL);
+}
+
+static void
+handle_signal(int sig)
+{
+    if (signal_received != SIGTERM)
+        signal_received = sig;
+}
+
+/* Writes a checkpoint if one is due and the previous epoch is complete. Returns 1 if the run should end (SIGTERM). */
+int
+checkpoint_poll(MCproblem *mcp, Population *parent_population, int *receive_idx, unsigned int n_generations, double run_time)
+{
+    int flag, stop;
+
+    if (epoch_request != MPI_REQUEST_NULL) {
+        MPI_Test(&epoch_request, &flag, MPI_STATUS_IGNORE);
+        if (!flag)
+            return 0;
+    }
+    if (!signal_received && (MPI_Wtime() - last_time < mcp->checkpoint_interval))
+        return 0;
+
+    write_checkpoint(mcp, parent_population, receive_idx, n_generations, run_time);
+    MPI_Ibarrier(checkpoint_comm, &epoch_request);
+    last_time = MPI_Wtime();
+    stop = (signal_received == SIGTERM);
+    if (mcp->verbose || signal_received)
+        printf("PE: %i\t Checkpoint %u written at generation %u%s\t Time:%.1fs\n", mpi_pe, epoch, n_generations - 1, signal_received ? " (signal)" : "", run_time);
+    signal_received = 0;
+    return stop;
+}
+
+/* Collective. Writes the final state as a new epoch of all islands (islands one epoch behind write it twice). */
+void
+checkpoint_finalize(MCproblem *mcp, Population *parent_population, int *receive_idx, unsigned int n_generations, double run_time)
+{
+    unsigned int max_epoch;
+
+    MPI_Allreduce(&epoch, &max_epoch, 1, MPI_UNSIGNED, MPI_MAX, MPI_COMM_WORLD);
+    while (epoch <= max_epoch) {
+        MPI_Wait(&epoch_request, MPI_STATUS_IGNORE);
+        write_checkpoint(mcp, parent_population, receive_idx, n_generations, run_time);
+        MPI_Ibarrier(checkpoint_comm, &epoch_request);
+    }
+    MPI_Wait(&epoch_request, MPI_STATUS_IGNORE);
+    MPI_Comm_free(&checkpoint_comm);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGUSR1, SIG_DFL);
+}
+
+static void
+write_checkpoint(MCproblem *mcp, Population *parent_population, int *receive_idx, unsigned int n_generations, double run_time)
+{
+    char path[300], tmp_path[310];
+    CheckpointHeader header;
+    FILE *f;
+
+    epoch++;
+    sprintf(path, "%s_%i.ckpt%u", mcp->checkpoint_path, mpi_pe, epoch % 2);
+    sprintf(tmp_path, "%s.tmp", path);
+    if (!(f = fopen(tmp_path, "wb"))) {
+        fprintf(stderr, "error: file open failed '%s'.\n", tmp_path);
+        exit(-1);
+    }
+    set_header(mcp, &header, epoch);
+    checkpoint_io(&header, sizeof header, f, 0);
+    core_io(mcp, f, 0, parent_population, &n_generations, &run_time);
+    state_io(mcp, f, 0, receive_idx);
+    if ((fflush(f) != 0) || (fsync(fileno(f)) != 0) || (fclose(f) != 0) || (rename(tmp_path, path) != 0)) {
+        fprintf(stderr, "error: writing checkpoint '%s'.\n", path);
+        exit(-1);
+    }
+}
+
+/* Collective. Loads the parent population and counters of the last epoch written by all islands, the rest of the state is restored by checkpoint_restore_state() once the modules are initialized. */
+void
+checkpoint_load(MCproblem *mcp, Population *parent_population, unsigned int *n_generations, double *run_time)
+{
+    char path[300];
+    unsigned int latest = 0, slot_epoch, common;
+    FILE *f;
+
+    for (int slot=0; slot < 2; slot++) {
+        sprintf(path, "%s_%i.ckpt%i", mcp->checkpoint_path, mpi_pe, slot);
+        if ((f = fopen(path, "rb"))) {
+            slot_epoch = read_header(mcp, f);
+            if (slot_epoch > latest)
+                latest = slot_epoch;
+            fclose(f);
+        }
+    }
+    MPI_Allreduce(&latest, &common, 1, MPI_UNSIGNED, MPI_MIN, MPI_COMM_WORLD);
+    if (common == 0) {
+        fprintf(stderr, "error: No checkpoint written by all islands was found for '%s'.\n", mcp->checkpoint_path);
+        exit(-1);
+    }
+
+    sprintf(path, "%s_%i.ckpt%u", mcp->checkpoint_path, mpi_pe, common % 2);
+    if (!(resume_fp = fopen(path, "rb")) || (read_header(mcp, resume_fp) != common)) {
+        fprintf(stderr, "error: Checkpoint epoch %u not found in '%s'.\n", common, path);
+        exit(-1);
+    }
+    core_io(mcp, resume_fp, 1, parent_population, n_generations, run_time);
+    epoch = common;
+    if (mpi_pe == 0) printf("Resuming from checkpoint epoch %u\n", common);
+}
+
+void
+checkpoint_restore_state(MCproblem *mcp, Population *parent_population, int *receive_idx)
+{
+    state_io(mcp, resume_fp, 1, receive_idx);
+    fclose(resume_fp);
+    resume_fp = NULL;
+    if (mcp->guided_mutation)
+        gene_model_update(mcp, parent_population, parent_population->size, 1);
+}
+
+/* Returns the epoch of the checkpoint or 0 if it is not a complete checkpoint, exits if it belongs to a run with other parameters */
+static unsigned int
+read_header(MCproblem *mcp, FILE *f)
+{
+    CheckpointHeader header, expected;
+
+    if ((fread(&header, sizeof header, 1, f) != 1) || (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof header.magic) != 0))
+        return 0;
+    set_header(mcp, &expected, header.epoch);
+    if (memcmp(&header, &expected, sizeof header) != 0) {
+        fprintf(stderr, "error: The checkpoint of island %i was written with other parameters or another number of PEs.\n", mpi_pe);
+        exit(-1);
+    }
+    return header.epoch;
+}
+
+static void
+set_header(MCproblem *mcp, CheckpointHeader *header, unsigned int header_epoch)
+{
+    memset(header, 0, sizeof *header);
+    memcpy(header->magic, CHECKPOINT_MAGIC, sizeof header->magic);
+    header->epoch = header_epoch;
+    header->comm_size = mpi_comm_size;
+    header->n_vars = mcp->n_vars;
+    header->n_models = mcp->n_models;
+    header->population_size = mcp->population_size;
+    header->migration_size = (mpi_comm_size > 1) ? mcp->migration_size : 0;
+    header->use_modules = mcp->use_modules;
+    header->adaptive_operators = mcp->adaptive_operators;
+}
+
+/* Writes, or reads back if restore is set, size bytes at data */
+void
+checkpoint_io(void *data, size_t size, FILE *f, int restore)
+{
+    if (restore ? (fread(data, size, 1, f) != 1) : (fwrite(data, size, 1, f) != 1)) {
+        fprintf(stderr, "error: %s checkpoint.\n", restore ? "Truncated" : "Writing");
+        exit(-1);
+    }
+}
+
+static void
+core_io(MCproblem *mcp, FILE *f, int restore, Population *pop, unsigned int *n_generations, double *run_time)
+{
+    int has_blacklist = (mcp->blacklist != NULL);
+    Individual *indv;
+
+    checkpoint_io(n_generations, sizeof *n_generations, f, restore);
+    checkpoint_io(run_time, sizeof *run_time, f, restore);
+    checkpoint_io(&variation_round, sizeof variation_round, f, restore);
+    for (int i=0; i < mcp->population_size; i++) {
+        indv = &(pop->indv[i]);
+        checkpoint_io(indv->deletions, mcp->n_vars * sizeof *indv->deletions, f, restore);
+        if (mcp->use_modules)
+            checkpoint_io(indv->modules, mcp->n_models * mcp->n_vars * sizeof *indv->modules, f, restore);
+        checkpoint_io(indv->objectives, mcp->n_models * sizeof *indv->objectives, f, restore);
+        checkpoint_io(indv->penalty_objectives, mcp->n_models * sizeof *indv->penalty_objectives, f, restore);
+        checkpoint_io(&(indv->rank), sizeof indv->rank, f, restore);
+        checkpoint_io(&(indv->crowding_distance), sizeof indv->crowding_distance, f, restore);
+        checkpoint_io(&(indv->operators), sizeof indv->operators, f, restore);
+    }
+
+    /* The deletion screening is not run again when resuming */
+    checkpoint_io(&has_blacklist, sizeof has_blacklist, f, restore);
+    if (has_blacklist) {
+        if (restore && (mcp->blacklist == NULL))
+            SAFE_ALLOC(mcp->blacklist = malloc(mcp->n_vars * sizeof *mcp->blacklist))
+        checkpoint_io(mcp->blacklist, mcp->n_vars * sizeof *mcp->blacklist, f, restore);
+    }
+}
+
+static void
+state_io(MCproblem *mcp, FILE *f, int restore, int *receive_idx)
+{
+    checkpoint_io(pcg32_global_state(), sizeof(pcg32_random_t), f, restore);
+    if (mpi_comm_size > 1) {
+        checkpoint_io(receive_idx, mcp->migration_size * sizeof *receive_idx, f, restore);
+        topology_checkpoint(mcp, f, restore);
+        schedule_checkpoint(f, restore);
+    }
+    if (mcp->adaptive_operators)
+        adaptive_checkpoint(f, restore);
+}
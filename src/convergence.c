@@ -0,0 +1,86 @@
+/* Stall based termination. An island is stalled when, for stall_generations, the hypervolume has not increased by more than stall_epsilon (relative) and no new non-dominated objective vectors have appeared. The run stops once all islands are stalled.
+ * Notes:
+ *      - Front metrics (metrics.c) are evaluated every PRINT_INTERVAL generations, so the window is effectively rounded up to a multiple of it.
+ *      - The decision is shared through a non-blocking MPI_Iallreduce on a duplicated communicator, started at each check and polled every generation, so islands never wait on each other. Only one reduction is in flight per island, and since reductions are started in the same order everywhere all islands agree on the same outcome and stop after the same reduction.
+ *      - Islands may still stop on their own due to the generation or time limit, convergence_finalize() completes the reductions started by other islands to avoid leaving collectives unmatched.
+ */
+
+#include <stdlib.h>
+#include "modcell.h"
+
+void convergence_init(MCproblem *mcp);
+void convergence_check(MCproblem *mcp, FrontMetrics *fm, unsigned int generation);
+int convergence_poll(MCproblem *mcp);
+void convergence_finalize(MCproblem *mcp);
+
+extern int mpi_pe, mpi_comm_size;
+
+/* Globals */
+static MPI_Comm stall_comm;
+static MPI_Request stall_request;
+static int active_reduction;
+static int n_reductions; 	/* Number of reductions started */
+static int local_stalled, stall_send, global_stalled; /* stall_send is the reduction buffer, it must not change while a reduction is in flight */
+static double best_hypervolume;
+static unsigned int last_improvement;
+
+void
+convergence_init(MCproblem *mcp)
+{
+    MPI_Comm_dup(MPI_COMM_WORLD, &stall_comm);
+    active_reduction = 0;
+    n_reductions = 0;
+    best_hypervolume = 0;
+    last_improvement = 0;
+}
+
+/* Updates the local stall state with the latest front metrics and shares it with the other islands */
+void
+convergence_check(MCproblem *mcp, FrontMetrics *fm, unsigned int generation)
+{
+    if ((fm->hypervolume > best_hypervolume * (1 + mcp->stall_epsilon)) || (fm->new_points > 0))
+        last_improvement = generation;
+    if (fm->hypervolume > best_hypervolume)
+        best_hypervolume = fm->hypervolume;
+
+    local_stalled = (generation - last_improvement) >= mcp->stall_generations;
+
+    if (!active_reduction) {
+        stall_send = local_stalled;
+        MPI_Iallreduce(&stall_send, &global_stalled, 1, MPI_INT, MPI_LAND, stall_comm, &stall_request);
+        active_reduction = 1;
+        n_reductions++;
+    }
+}
+
+/* Returns 1 once all islands agree that they are stalled */
+int
+convergence_poll(MCproblem *mcp)
+{
+    int flag = 0;
+
+    if (!active_reduction)
+        return 0;
+    MPI_Test(&stall_request, &flag, MPI_STATUS_IGNORE);
+    if (!flag)
+        return 0;
+    active_reduction = 0;
+    return global_stalled;
+}
+
+/* Completes pending reductions so that every island has taken part in the same number of them */
+void
+convergence_finalize(MCproblem *mcp)
+{
+    int max_reductions;
+
+    MPI_Allreduce(&n_reductions, &max_reductions, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (active_reduction)
+        MPI_Wait(&stall_request, MPI_STATUS_IGNORE);
+    stall_send = 0;
+    for (; n_reductions < max_reductions; n_reductions++) { /* Non-blocking and blocking collectives do not match */
+        MPI_Iallreduce(&stall_send, &global_stalled, 1, MPI_INT, MPI_LAND, stall_comm, &stall_request);
+        MPI_Wait(&stall_request, MPI_STATUS_IGNORE);
+    }
+    MPI_Comm_free(&stall_comm);
+}
@@ -0,0 +1,273 @@
+/* Exhaustive enumeration of all designs with up to alpha deletions (no module reactions), for small alpha. Gives the exact Pareto front, e.g., as a reference to benchmark the MOEA.
+ * Notes:
+ *      - Deletion sets are visited depth first (each set before its supersets), so consecutive sets mostly differ in one or two bounds (one deletion added, or one removed and one added), up to alpha+1 when backtracking from a deepest set, and every model LP is warm-started from the basis of the previous set.
+ *      - Infeasibility is inherited by supersets, so once a set is infeasible in a model (lethal) that model is not solved for its supersets, and if it is lethal in all models its supersets are skipped.
+ *      - The first deletion of each set decides the MPI rank that evaluates it (snake order over ranks to balance subtree sizes). Each rank keeps the non-dominated designs it finds and rank 0 gathers, filters and writes them.
+ *      - Designs with the same objectives as a design already kept are discarded, so among equivalent designs the one with fewer deletions found first is kept.
+ *      - Every FLUSH_INTERVAL seconds (checked after each first deletion) each rank writes the designs it keeps to OUTPUT_FILE_<PE>.part, under a temporary name and renamed, so a killed enumeration keeps what it found. The union of the .part files is a superset of the front of the sets enumerated so far; they are removed once OUTPUT_FILE is written.
+ */
+
+#include <stdlib.h>
+#include "modcell.h"
+
+#define FRONT_INITIAL_CAPACITY 64
+#define FLUSH_INTERVAL 60.0 	/* Seconds between writes of the partial front */
+
+extern glp_smcp param;
+extern int mpi_pe, mpi_comm_size;
+
+void run_enumeration(MCproblem *mcp, char *out_population_path);
+static void visit(MCproblem *mcp, int first, int depth, unsigned char *lethal);
+static void set_deletion(MCproblem *mcp, int j, int deleted);
+static void offer(MCproblem *mcp, double *objectives, int n_deleted);
+static void gather_front(MCproblem *mcp);
+static void flush_front(MCproblem *mcp, char *out_population_path);
+
+/* Globals */
+static int *deleted_rxns; 	/* [alpha] Current deletion set */
+static double *objectives; 	/* [(alpha+1)*n_models] Objectives of the current set at each depth */
+static unsigned char *lethal_sets; /* [(alpha+1)*n_models] Lethality of the current set at each depth */
+static Population front; 	/* front.size is the number of designs */
+static size_t front_capacity;
+static unsigned long n_evaluated, n_pruned;
+
+/* Enumerates all deletion sets of size up to alpha and writes the non-dominated ones to out_population_path */
+void
+run_enumeration(MCproblem *mcp, char *out_population_path)
+{
+    int i, j, k, rank;
+    double time_start = MPI_Wtime(), last_flush = time_start;
+    char part_path[300];
+
+    if (mcp->use_modules) {
+        fprintf(stderr, "error: Enumeration does not support module reactions, set beta to 0.\n");
+        exit(-1);
+    }
+
+    SAFE_ALLOC(deleted_rxns = malloc((mcp->alpha + 1) * sizeof *deleted_rxns))
+    SAFE_ALLOC(objectives = malloc((mcp->alpha + 1) * mcp->n_models * sizeof *objectives))
+    SAFE_ALLOC(lethal_sets = calloc((mcp->alpha + 1) * mcp->n_models, sizeof *lethal_sets))
+    front_capacity = FRONT_INITIAL_CAPACITY;
+    allocate_population(mcp, &front, front_capacity);
+    set_blank_population(mcp, &front);
+    front.size = 0;
+    n_evaluated = n_pruned = 0;
+
+    if (mpi_pe == 0) { /* Design without deletions */
+        for (k=0; k < mcp->n_models; k++)
+            objectives[k] = mcp->lps[k].no_deletion_objective;
+        offer(mcp, objectives, 0);
+    }
+
+    for (j=0; (mcp->alpha > 0) && (j < mcp->n_vars); j++) {
+        i = j % (2*mpi_comm_size); /* Snake order */
+        rank = (i < mpi_comm_size) ? i : 2*mpi_comm_size - 1 - i;
+        if (rank != mpi_pe)
+            continue;
+        visit(mcp, j, 1, lethal_sets);
+        if (mcp->verbose)
+            printf("PE: %i\t Enumerated first deletion %i of %zu\t Evaluated: %lu\t Pruned: %lu\t Front: %zu\t Time:%.1fs\n", mpi_pe, j+1, mcp->n_vars, n_evaluated, n_pruned, front.size, MPI_Wtime() - time_start);
+        if (MPI_Wtime() - last_flush >= FLUSH_INTERVAL) {
+            flush_front(mcp, out_population_path);
+            last_flush = MPI_Wtime();
+        }
+    }
+
+    gather_front(mcp);
+    if (mpi_pe == 0) {
+        printf("Enumeration done, %zu non-dominated designs. Time:%.1fs\n", front.size, MPI_Wtime() - time_start);
+        write_population(mcp, &front, out_population_path);
+    }
+    MPI_Barrier(MPI_COMM_WORLD); /* The output is written before the partial fronts are removed */
+    snprintf(part_path, sizeof part_path, "%s_%i.part", out_population_path, mpi_pe);
+    remove(part_path);
+
+    front.size = front_capacity;
+    free_population(mcp, &front);
+    free(deleted_rxns);
+    free(objectives);
+    free(lethal_sets);
+}
+
+/* Evaluates the current set plus deletion j (at position depth) and then its supersets with deletions above j */
+static void
+visit(MCproblem *mcp, int j, int depth, unsigned char *lethal)
+{
+    LPproblem *lp;
+    int k, j2, ret, n_lethal = 0;
+    double *obj = &(objectives[depth*mcp->n_models]);
+    unsigned char *is_lethal = &(lethal[depth*mcp->n_models]);
+
+    deleted_rxns[depth-1] = j;
+    set_deletion(mcp, j, 1);
+
+    for (k=0; k < mcp->n_models; k++) {
+        lp = &(mcp->lps[k]);
+        is_lethal[k] = lethal[(depth-1)*mcp->n_models + k];
+        obj[k] = 0;
+        if (is_lethal[k]) {
+            n_lethal++;
+            continue;
+        }
+        ret = glp_simplex(lp->P, &param);
+        if ((ret == 0) && (glp_get_status(lp->P) == GLP_OPT))
+            obj[k] = glp_get_col_prim(lp->P, lp->prod_col_idx)/lp->max_prod_growth;
+        else if ((ret == 0) && (glp_get_status(lp->P) == GLP_NOFEAS))
+            is_lethal[k] = 1;
+        n_lethal += is_lethal[k];
+    }
+    n_evaluated++;
+
+    if (n_lethal < mcp->n_models) {
+        offer(mcp, obj, depth);
+        if (depth < mcp->alpha)
+            for (j2=j+1; j2 < mcp->n_vars; j2++)
+                visit(mcp, j2, depth+1, lethal);
+    }
+    else if (depth < mcp->alpha) {
+        n_pruned++;
+    }
+
+    set_deletion(mcp, j, 0);
+}
+
+static void
+set_deletion(MCproblem *mcp, int j, int deleted)
+{
+    LPproblem *lp;
+
+    for (int k=0; k < mcp->n_models; k++) {
+        lp = &(mcp->lps[k]);
+        if (lp->cand_col_idx[j] == NOT_CANDIDATE)
+            continue;
+        if (deleted)
+            glp_set_col_bnds(lp->P, lp->cand_col_idx[j], GLP_FX, 0, 0);
+        else
+            glp_set_col_bnds(lp->P, lp->cand_col_idx[j], lp->cand_col_type[j], lp->cand_og_lb[j], lp->cand_og_ub[j]);
+    }
+}
+
+/* Adds the design given by the first n_deleted elements of deleted_rxns to the front if no design in the front dominates or equals it */
+static void
+offer(MCproblem *mcp, double *obj, int n_deleted)
+{
+    size_t i;
+    int k, a_dominates_b, b_dominates_a;
+    Individual tmp, *indv;
+
+    for (i=0; i < front.size; ) {
+        a_dominates_b = b_dominates_a = 1; /* a: front member, b: new design */
+        for (k=0; k < mcp->n_models; k++) {
+            if (front.indv[i].objectives[k] > obj[k])
+                b_dominates_a = 0;
+            if (obj[k] > front.indv[i].objectives[k])
+                a_dominates_b = 0;
+        }
+        if (a_dominates_b) /* Also if equal */
+            return;
+        if (b_dominates_a) { /* Remove member, the last one takes its place */
+            tmp = front.indv[i];
+            front.indv[i] = front.indv[front.size - 1];
+            front.indv[front.size - 1] = tmp;
+            front.size--;
+        }
+        else {
+            i++;
+        }
+    }
+
+    if (front.size == front_capacity) {
+        front_capacity *= 2;
+        SAFE_ALLOC(front.indv = realloc(front.indv, front_capacity * sizeof *front.indv))
+        for (i=front.size; i < front_capacity; i++)
+            allocate_individual(mcp, &(front.indv[i]));
+    }
+    indv = &(front.indv[front.size++]);
+    set_blank_individual(mcp, indv);
+    for (k=0; k < mcp->n_models; k++) {
+        indv->objectives[k] = obj[k];
+        indv->penalty_objectives[k] = obj[k];
+    }
+    for (k=0; k < n_deleted; k++)
+        indv->deletions[deleted_rxns[k]] = DELETED_RXN;
+}
+
+/* Rank 0 receives the fronts of all ranks and keeps their non-dominated designs */
+static void
+gather_front(MCproblem *mcp)
+{
+    int i, j, k, pe, n = front.size, *counts = NULL, *recv_del = NULL, *send_del;
+    double *recv_obj = NULL, *send_obj;
+    int *counts_del = NULL, *displs_del = NULL, *counts_obj = NULL, *displs_obj = NULL, total = 0;
+
+    if (mpi_comm_size == 1)
+        return;
+
+    /* Deletions are sent as alpha indices per design, padded with -1 */
+    SAFE_ALLOC(send_del = malloc((n * mcp->alpha + 1) * sizeof *send_del))
+    SAFE_ALLOC(send_obj = malloc((n * mcp->n_models + 1) * sizeof *send_obj))
+    for (i=0; i < n; i++) {
+        for (j=0, k=0; j < mcp->n_vars; j++)
+            if (front.indv[i].deletions[j] == DELETED_RXN)
+                send_del[i*mcp->alpha + k++] = j;
+        for (; k < mcp->alpha; k++)
+            send_del[i*mcp->alpha + k] = -1;
+        for (k=0; k < mcp->n_models; k++)
+            send_obj[i*mcp->n_models + k] = front.indv[i].objectives[k];
+    }
+
+    if (mpi_pe == 0) {
+        SAFE_ALLOC(counts = malloc(mpi_comm_size * sizeof *counts))
+        SAFE_ALLOC(counts_del = malloc(mpi_comm_size * sizeof *counts_del))
+        SAFE_ALLOC(displs_del = malloc(mpi_comm_size * sizeof *displs_del))
+        SAFE_ALLOC(counts_obj = malloc(mpi_comm_size * sizeof *counts_obj))
+        SAFE_ALLOC(displs_obj = malloc(mpi_comm_size * sizeof *displs_obj))
+    }
+    MPI_Gather(&n, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (mpi_pe == 0) {
+        for (pe=0; pe < mpi_comm_size; pe++) {
+            counts_del[pe] = counts[pe] * mcp->alpha;
+            displs_del[pe] = total * mcp->alpha;
+            counts_obj[pe] = counts[pe] * mcp->n_models;
+            displs_obj[pe] = total * mcp->n_models;
+            total += counts[pe];
+        }
+        SAFE_ALLOC(recv_del = malloc((total * mcp->alpha + 1) * sizeof *recv_del))
+        SAFE_ALLOC(recv_obj = malloc((total * mcp->n_models + 1) * sizeof *recv_obj))
+    }
+    MPI_Gatherv(send_del, n * mcp->alpha, MPI_INT, recv_del, counts_del, displs_del, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(send_obj, n * mcp->n_models, MPI_DOUBLE, recv_obj, counts_obj, displs_obj, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    if (mpi_pe == 0) {
+        front.size = 0;
+        for (i=0; i < total; i++) {
+            for (k=0; (k < mcp->alpha) && (recv_del[i*mcp->alpha + k] != -1); k++)
+                deleted_rxns[k] = recv_del[i*mcp->alpha + k];
+            offer(mcp, &(recv_obj[i*mcp->n_models]), k);
+        }
+        free(counts);
+        free(counts_del);
+        free(displs_del);
+        free(counts_obj);
+        free(displs_obj);
+        free(recv_del);
+        free(recv_obj);
+    }
+    free(send_del);
+    free(send_obj);
+}
+
+/* Writes the designs kept by this rank to <out_population_path>_<PE>.part */
+static void
+flush_front(MCproblem *mcp, char *out_population_path)
+{
+    char path[300], tmp_path[310];
+
+    snprintf(path, sizeof path, "%s_%i.part", out_population_path, mpi_pe);
+    snprintf(tmp_path, sizeof tmp_path, "%s.tmp", path);
+    write_population(mcp, &front, tmp_path);
+    if (rename(tmp_path, path) != 0) {
+        fprintf(stderr, "error: renaming '%s' failed.\n", tmp_path);
+        exit(-1);
+    }
+}
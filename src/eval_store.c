@@ -0,0 +1,350 @@
+/* Persistent evaluation store. Objectives of solved (model, effective knockout set) pairs, see knockout_key(), are kept in a file that later runs on the same problem load at startup, so repeated studies (e.g., other alpha, beta, seeds or initial populations) do not solve the same LPs again.
+ * Notes:
+ *      - File layout: a StoreHeader followed by StoreRecord entries. The header holds a fingerprint of the problem directory (names and contents of the cand, .mps, .ncand and .param files), a store built for another problem or another version of the files is refused.
+ *      - The records are memory mapped read-only at startup and indexed by an open addressing hash table. New results are added to the index and appended to the end of the file in batches (O_APPEND writes of whole records, so ranks can append concurrently on a local file system). Results appended by other ranks during the run are only seen by later runs.
+ *      - A record cut by an interrupted run is dropped at startup. A key may appear more than once (e.g., solved by two islands in the same run), the first record is used.
+ *      - Objectives read from .pop files are added to the index only (read_population()), they are trusted to belong to the problem but are never appended to the file, since they are rounded and failed solves are written as 0, so only exact LP results persist across runs.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "modcell.h"
+
+#define STORE_MAGIC "MCSTORE1"
+#define STORE_BATCH 512 	/* Records appended per write */
+#define STORE_INITIAL_CAPACITY 4096 /* Index slots, power of two */
+
+extern int mpi_pe, mpi_comm_size;
+
+typedef struct {
+	char magic[8];
+	uint64_t fingerprint;
+	uint32_t n_models;
+	uint32_t record_size;
+} StoreHeader;
+
+typedef struct {
+	uint64_t key; 		/* See knockout_key() */
+	double objective;
+} StoreRecord;
+
+void eval_store_init(MCproblem *mcp, const char *problem_dir_path);
+void eval_store_free(MCproblem *mcp);
+int eval_store_lookup(MCproblem *mcp, Individual *indv, uint64_t *keys, int *hit);
+void eval_store_insert(MCproblem *mcp, uint64_t key, double objective);
+void eval_store_add_individual(MCproblem *mcp, Individual *indv);
+static void prepare_file(MCproblem *mcp, uint64_t fingerprint);
+static uint64_t problem_fingerprint(const char *problem_dir_path);
+static int is_problem_file(const char *name);
+static int compare_names(const void *a, const void *b);
+static StoreRecord * record_at(size_t id);
+static long find_slot(uint64_t key);
+static int index_insert(uint64_t key, double objective);
+static void flush_batch(void);
+
+/* Globals */
+static void *map_base; 		/* Mapped file, NULL if it has no records */
+static size_t map_size;
+static StoreRecord *mapped; 	/* [n_mapped] Records of the file at startup */
+static size_t n_mapped;
+static StoreRecord *added; 	/* [added_capacity] Records added during the run */
+static size_t n_added, added_capacity;
+static uint64_t *slot_keys; 	/* [capacity] 0 marks an empty slot */
+static size_t *slot_ids; 	/* [capacity] Record ids, below n_mapped for mapped records */
+static size_t capacity;
+static StoreRecord batch[STORE_BATCH];
+static int n_batch;
+static int append_fd;
+static unsigned long n_lookups, n_hits, n_appended;
+
+/* Collective */
+void
+eval_store_init(MCproblem *mcp, const char *problem_dir_path)
+{
+    int fd;
+    struct stat st;
+    uint64_t fingerprint = 0;
+
+    if (mpi_pe == 0) {
+        fingerprint = problem_fingerprint(problem_dir_path);
+        prepare_file(mcp, fingerprint);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    if ((fd = open(mcp->eval_store_path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+        fprintf(stderr, "error: opening evaluation store '%s'.\n", mcp->eval_store_path);
+        exit(-1);
+    }
+    map_size = st.st_size;
+    n_mapped = (map_size - sizeof(StoreHeader)) / sizeof(StoreRecord);
+    map_base = NULL;
+    mapped = NULL;
+    if (n_mapped > 0) {
+        if ((map_base = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+            fprintf(stderr, "error: mapping evaluation store '%s'.\n", mcp->eval_store_path);
+            exit(-1);
+        }
+        mapped = (StoreRecord *)((char *)map_base + sizeof(StoreHeader));
+    }
+    close(fd);
+    if ((append_fd = open(mcp->eval_store_path, O_WRONLY | O_APPEND)) == -1) {
+        fprintf(stderr, "error: opening evaluation store '%s' for writing.\n", mcp->eval_store_path);
+        exit(-1);
+    }
+
+    for (capacity = STORE_INITIAL_CAPACITY; capacity < 2*n_mapped; capacity *= 2);
+    SAFE_ALLOC(slot_keys = calloc(capacity, sizeof *slot_keys))
+    SAFE_ALLOC(slot_ids = malloc(capacity * sizeof *slot_ids))
+    added_capacity = STORE_INITIAL_CAPACITY;
+    SAFE_ALLOC(added = malloc(added_capacity * sizeof *added))
+    n_added = 0;
+    for (size_t id=0; id < n_mapped; id++) {
+        long s = find_slot(mapped[id].key);
+        if (slot_keys[s] == 0) { /* First record of the key */
+            slot_keys[s] = mapped[id].key;
+            slot_ids[s] = id;
+        }
+    }
+    n_batch = 0;
+    n_lookups = n_hits = n_appended = 0;
+    if (mpi_pe == 0) printf("Evaluation store: %zu results loaded from %s\n", n_mapped, mcp->eval_store_path);
+}
+
+void
+eval_store_free(MCproblem *mcp)
+{
+    flush_batch();
+    close(append_fd);
+    if (mcp->verbose)
+        printf("PE: %i\t Evaluation store hits:%lu of %lu lookups, %lu new results\n", mpi_pe, n_hits, n_lookups, n_appended);
+    if (map_base)
+        munmap(map_base, map_size);
+    free(added);
+    free(slot_keys);
+    free(slot_ids);
+}
+
+/* Same as fitness_cache_lookup() */
+int
+eval_store_lookup(MCproblem *mcp, Individual *indv, uint64_t *keys, int *hit)
+{
+    int k, n = 0;
+    long s;
+
+    for (k=0; k < mcp->n_models; k++) {
+        if (hit[k])
+            continue;
+        n_lookups++;
+        s = find_slot(keys[k]);
+        if (slot_keys[s] != 0) {
+            indv->objectives[k] = record_at(slot_ids[s])->objective;
+            hit[k] = 1;
+            n++;
+        }
+    }
+    n_hits += n;
+    return n;
+}
+
+/* Adds a result, unless its key is already stored */
+void
+eval_store_insert(MCproblem *mcp, uint64_t key, double objective)
+{
+    if (!index_insert(key, objective))
+        return;
+    batch[n_batch].key = key;
+    batch[n_batch].objective = objective;
+    n_appended++;
+    if (++n_batch == STORE_BATCH)
+        flush_batch();
+}
+
+/* Adds the objectives of an individual with known objectives (e.g., read from a population file) to the index, for this run only */
+void
+eval_store_add_individual(MCproblem *mcp, Individual *indv)
+{
+    int k, *change_bound;
+    uint64_t key;
+
+    SAFE_ALLOC(change_bound = malloc(mcp->n_vars * sizeof *change_bound))
+    for (k=0; k < mcp->n_models; k++) {
+        if (indv->objectives[k] == UNKNOWN_OBJ)
+            continue;
+        key = knockout_key(mcp, indv, k, change_bound);
+        index_insert(key, indv->objectives[k]);
+    }
+    free(change_bound);
+}
+
+/* PE 0: Creates the file or checks that it belongs to the problem, and drops an incomplete last record */
+static void
+prepare_file(MCproblem *mcp, uint64_t fingerprint)
+{
+    int fd;
+    struct stat st;
+    StoreHeader header, file_header;
+
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, STORE_MAGIC, sizeof header.magic);
+    header.fingerprint = fingerprint;
+    header.n_models = mcp->n_models;
+    header.record_size = sizeof(StoreRecord);
+
+    if ((fd = open(mcp->eval_store_path, O_RDWR | O_CREAT, 0644)) == -1 || fstat(fd, &st) == -1) {
+        fprintf(stderr, "error: opening evaluation store '%s'.\n", mcp->eval_store_path);
+        exit(-1);
+    }
+    if (st.st_size < sizeof header) {
+        if (st.st_size > 0)
+            printf("Evaluation store '%s' has no valid header, it is created again\n", mcp->eval_store_path);
+        if (ftruncate(fd, 0) == -1 || write(fd, &header, sizeof header) != sizeof header) {
+            fprintf(stderr, "error: writing evaluation store '%s'.\n", mcp->eval_store_path);
+            exit(-1);
+        }
+    }
+    else {
+        if (read(fd, &file_header, sizeof file_header) != sizeof file_header || memcmp(&file_header, &header, sizeof header) != 0) {
+            fprintf(stderr, "error: evaluation store '%s' belongs to another problem (or another version of its files).\n", mcp->eval_store_path);
+            exit(-1);
+        }
+        if (((st.st_size - sizeof header) % sizeof(StoreRecord) != 0) &&
+                (ftruncate(fd, st.st_size - (st.st_size - sizeof header) % sizeof(StoreRecord)) == -1)) {
+            fprintf(stderr, "error: writing evaluation store '%s'.\n", mcp->eval_store_path);
+            exit(-1);
+        }
+    }
+    close(fd);
+}
+
+/* FNV-1a hash of the names and contents of the problem files, in name order */
+static uint64_t
+problem_fingerprint(const char *problem_dir_path)
+{
+    uint64_t h = 14695981039346656037ULL;
+    char path[512], **names = NULL;
+    int i, c, n = 0, n_max = 0;
+    DIR *d;
+    struct dirent *entry;
+    FILE *f;
+
+    if (!(d = opendir(problem_dir_path))) {
+        fprintf(stderr, "error: opening problem directory: '%s'.\n", problem_dir_path);
+        exit(-1);
+    }
+    while ((entry = readdir(d)) != NULL) {
+        if (!is_problem_file(entry->d_name))
+            continue;
+        if (n == n_max) {
+            n_max = n_max ? 2*n_max : 16;
+            SAFE_ALLOC(names = realloc(names, n_max * sizeof *names))
+        }
+        names[n++] = strdup(entry->d_name);
+    }
+    closedir(d);
+    qsort(names, n, sizeof *names, compare_names);
+
+    for (i=0; i < n; i++) {
+        for (c=0; names[i][c] != '\0'; c++)
+            h = (h ^ (unsigned char)names[i][c]) * 1099511628211ULL;
+        h = (h ^ 0) * 1099511628211ULL;
+        snprintf(path, sizeof path, "%s/%s", problem_dir_path, names[i]);
+        if (!(f = fopen(path, "rb"))) {
+            fprintf(stderr, "error: file open failed '%s'.\n", path);
+            exit(-1);
+        }
+        while ((c = fgetc(f)) != EOF)
+            h = (h ^ (unsigned char)c) * 1099511628211ULL;
+        fclose(f);
+        free(names[i]);
+    }
+    free(names);
+    return h;
+}
+
+static int
+is_problem_file(const char *name)
+{
+    const char *ext = strrchr(name, '.');
+
+    if (strcmp(name, "cand") == 0)
+        return 1;
+    return ext && ((strcmp(ext, ".mps") == 0) || (strcmp(ext, ".ncand") == 0) || (strcmp(ext, ".param") == 0));
+}
+
+static int
+compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static StoreRecord *
+record_at(size_t id)
+{
+    return (id < n_mapped) ? &(mapped[id]) : &(added[id - n_mapped]);
+}
+
+/* Slot of key, or the empty slot where it would go (linear probing) */
+static long
+find_slot(uint64_t key)
+{
+    size_t s = key & (capacity - 1);
+
+    while ((slot_keys[s] != 0) && (slot_keys[s] != key))
+        s = (s + 1) & (capacity - 1);
+    return s;
+}
+
+/* Returns 1 if the key was new */
+static int
+index_insert(uint64_t key, double objective)
+{
+    size_t i, old_capacity;
+    uint64_t *old_keys;
+    size_t *old_ids;
+    long s = find_slot(key);
+
+    if (slot_keys[s] != 0)
+        return 0;
+    if (n_added == added_capacity) {
+        added_capacity *= 2;
+        SAFE_ALLOC(added = realloc(added, added_capacity * sizeof *added))
+    }
+    added[n_added].key = key;
+    added[n_added].objective = objective;
+    slot_keys[s] = key;
+    slot_ids[s] = n_mapped + n_added++;
+
+    if (2*(n_mapped + n_added) > capacity) { /* Grow and rehash */
+        old_capacity = capacity;
+        old_keys = slot_keys;
+        old_ids = slot_ids;
+        capacity *= 2;
+        SAFE_ALLOC(slot_keys = calloc(capacity, sizeof *slot_keys))
+        SAFE_ALLOC(slot_ids = malloc(capacity * sizeof *slot_ids))
+        for (i=0; i < old_capacity; i++) {
+            if (old_keys[i] == 0)
+                continue;
+            s = find_slot(old_keys[i]);
+            slot_keys[s] = old_keys[i];
+            slot_ids[s] = old_ids[i];
+        }
+        free(old_keys);
+        free(old_ids);
+    }
+    return 1;
+}
+
+static void
+flush_batch(void)
+{
+    if (n_batch == 0)
+        return;
+    if (write(append_fd, batch, n_batch * sizeof *batch) != n_batch * sizeof *batch)
+        fprintf(stderr, "warning: PE %i could not append %i results to the evaluation store\n", mpi_pe, n_batch);
+    n_batch = 0;
+}
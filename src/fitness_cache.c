@@ -0,0 +1,132 @@
+/* Evaluation cache shared by all islands. The objective of model k only depends on its effective knockout set, the candidate reactions of model k that are deleted and not inserted back as modules, so solved (model, knockout set) pairs are stored in a hash table partitioned across MPI ranks and any island finding a pair solved by another one skips the LP.
+ * Notes:
+ *      - Each rank owns a slice of the table exposed as an MPI RMA window, a key belongs to rank key % mpi_comm_size. All ranks keep a passive target epoch open on the window (MPI_Win_lock_all) for the whole run, so lookups (MPI_Get of one bucket per model, a single flush per individual) and inserts (MPI_Put, completed lazily) never involve the owner and never wait for it.
+ *      - Buckets have CACHE_WAYS entries and an insert overwrites the entry selected by the key, so the table never needs to be read before writing. Older pairs are lost when the table fills up.
+ *      - Entries carry a check word derived from key and objective, so entries read while being written by another rank are ignored. Keys are 64 bit hashes, a different knockout set with the same hash would take its objective, which is very unlikely for the number of evaluations of a run.
+ *      - Only optimal solutions are stored.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "modcell.h"
+
+#define CACHE_WAYS 4
+#define CACHE_PENDING 256 	/* Inserts in flight before their buffers are reused */
+#define CHECK_SALT 0x5bd1e9955bd1e995ULL
+
+extern int mpi_pe, mpi_comm_size;
+
+typedef struct {
+	uint64_t key; 		/* 0 for empty entries */
+	double objective;
+	uint64_t check;
+} CacheEntry;
+
+void fitness_cache_init(MCproblem *mcp);
+void fitness_cache_free(MCproblem *mcp);
+int fitness_cache_lookup(MCproblem *mcp, Individual *indv, uint64_t *keys, int *hit);
+void fitness_cache_insert(MCproblem *mcp, uint64_t key, double objective);
+static uint64_t entry_check(uint64_t key, double objective);
+
+/* Globals */
+static MPI_Win cache_win;
+static CacheEntry *table; 	/* [n_buckets*CACHE_WAYS] Local slice */
+static size_t n_buckets;
+static CacheEntry *buckets; 	/* [n_models*CACHE_WAYS] Buckets read by the last lookup */
+static CacheEntry *pending; 	/* [CACHE_PENDING] */
+static int n_pending;
+static unsigned long n_lookups, n_hits;
+
+void
+fitness_cache_init(MCproblem *mcp)
+{
+    MPI_Aint size;
+
+    n_buckets = ((size_t)mcp->fitness_cache_mb << 20) / (CACHE_WAYS * sizeof(CacheEntry));
+    if (n_buckets == 0)
+        n_buckets = 1;
+    size = n_buckets * CACHE_WAYS * sizeof(CacheEntry);
+    MPI_Win_allocate(size, sizeof(CacheEntry), MPI_INFO_NULL, MPI_COMM_WORLD, &table, &cache_win);
+    memset(table, 0, size);
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Win_lock_all(0, cache_win);
+
+    SAFE_ALLOC(buckets = malloc(mcp->n_models * CACHE_WAYS * sizeof *buckets))
+    SAFE_ALLOC(pending = malloc(CACHE_PENDING * sizeof *pending))
+    n_pending = 0;
+    n_lookups = n_hits = 0;
+}
+
+/* Collective */
+void
+fitness_cache_free(MCproblem *mcp)
+{
+    if (mcp->verbose)
+        printf("PE: %i\t Fitness cache hits:%lu of %lu lookups\n", mpi_pe, n_hits, n_lookups);
+    MPI_Win_unlock_all(cache_win);
+    MPI_Win_free(&cache_win);
+    free(buckets);
+    free(pending);
+}
+
+/* Looks up the models without hit[k] set, whose keys (see knockout_key()) are in keys. Sets hit[k] to 1, and indv->objectives[k], for those found. Returns the number of hits. */
+int
+fitness_cache_lookup(MCproblem *mcp, Individual *indv, uint64_t *keys, int *hit)
+{
+    int k, w, n = 0, n_looked = 0;
+    CacheEntry *e;
+
+    for (k=0; k < mcp->n_models; k++) {
+        if (hit[k])
+            continue;
+        MPI_Get(&(buckets[k*CACHE_WAYS]), CACHE_WAYS*sizeof(CacheEntry), MPI_BYTE, keys[k] % mpi_comm_size,
+                ((keys[k] / mpi_comm_size) % n_buckets)*CACHE_WAYS, CACHE_WAYS*sizeof(CacheEntry), MPI_BYTE, cache_win);
+        n_looked++;
+    }
+    if (n_looked == 0)
+        return 0;
+    MPI_Win_flush_all(cache_win);
+
+    for (k=0; k < mcp->n_models; k++) {
+        if (hit[k])
+            continue;
+        for (w=0; w < CACHE_WAYS; w++) {
+            e = &(buckets[k*CACHE_WAYS + w]);
+            if ((e->key == keys[k]) && (e->check == entry_check(e->key, e->objective))) {
+                indv->objectives[k] = e->objective;
+                hit[k] = 1;
+                n++;
+                break;
+            }
+        }
+    }
+    n_lookups += n_looked;
+    n_hits += n;
+    return n;
+}
+
+void
+fitness_cache_insert(MCproblem *mcp, uint64_t key, double objective)
+{
+    CacheEntry *e;
+
+    if (n_pending == CACHE_PENDING) {
+        MPI_Win_flush_local_all(cache_win);
+        n_pending = 0;
+    }
+    e = &(pending[n_pending++]);
+    e->key = key;
+    e->objective = objective;
+    e->check = entry_check(key, objective);
+    MPI_Put(e, sizeof *e, MPI_BYTE, key % mpi_comm_size,
+            ((key / mpi_comm_size) % n_buckets)*CACHE_WAYS + (key >> 56) % CACHE_WAYS, sizeof *e, MPI_BYTE, cache_win);
+}
+
+static uint64_t
+entry_check(uint64_t key, double objective)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &objective, sizeof bits);
+    return (key ^ bits) * CHECK_SALT + 1;
+}
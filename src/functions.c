@@ -3,41 +3,46 @@
  */
 
 #include <stdlib.h>
+#include <math.h>
 #include <assert.h>
 #include "modcell.h"
 
 extern glp_smcp param;
+extern int mpi_pe;
+extern Kernels kernels;
 
 void copy_individual(MCproblem *mcp, Individual *indv_source, Individual *indv_dest);
 void combine_populations(MCproblem *mcp, Population *pop1, Population *pop2, Population *combined_pop);
 int find_domination(MCproblem *mcp, Individual *indv_a, Individual *indv_b);
-void crossover(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2);
-void mutation(MCproblem *mcp, Individual *indv);
-void enforce_module_constraints(MCproblem *mcp, Individual *indv);
+void crossover(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng);
+void crossover_two_point(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng);
+void crossover_uniform(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng);
+void mutation(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+void mutation_swap(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+void repair_alpha(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+int count_deletions(MCproblem *mcp, Individual *indv);
+void enforce_module_constraints(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+void set_rng_stream(MCproblem *mcp, pcg32_random_t *rng, unsigned int round, unsigned int index);
 void calculate_objectives(MCproblem *mcp, Individual *indv);
-void calculate_objective(MCproblem *mcp, Individual *indv, int k, int *change_bound);
+void calculate_objectives_basis(MCproblem *mcp, Individual *indv, unsigned char *basis_in, unsigned char *basis_out);
+int calculate_objective(MCproblem *mcp, Individual *indv, int k, int *change_bound);
+int solve_objective(MCproblem *mcp, Individual *indv, int k, int *change_bound, glp_smcp *parm);
+void set_penalty_objectives(MCproblem *mcp, Individual *indv);
+void save_basis(MCproblem *mcp, int k, unsigned char *basis);
+void load_basis(MCproblem *mcp, int k, unsigned char *basis);
+uint64_t genome_hash(MCproblem *mcp, Individual *indv);
+uint64_t knockout_key(MCproblem *mcp, Individual *indv, int k, int *change_bound);
+int is_same_genome(MCproblem *mcp, Individual *indv_a, Individual *indv_b);
+void allocate_genome_set(GenomeSet *set, size_t max_size);
+void free_genome_set(GenomeSet *set);
+void clear_genome_set(GenomeSet *set);
+int insert_genome(MCproblem *mcp, GenomeSet *set, Individual *indv);
 
 
 void
 copy_individual(MCproblem *mcp, Individual *indv_source, Individual *indv_dest)
 {
-    int j, k;
-
-    for (j=0; j < mcp->n_vars; j++)
-        indv_dest->deletions[j] = indv_source->deletions[j];
-
-    if (mcp->use_modules) {
-        for (k=0; k < mcp->n_models; k++)
-            for (j=0; j < mcp->n_vars; j++)
-                indv_dest->modules[k*mcp->n_vars + j] = indv_source->modules[k*mcp->n_vars + j];
-    }
-
-    for (k=0; k < mcp->n_models; k++) {
-        indv_dest->objectives[k] = indv_source->objectives[k];
-        indv_dest->penalty_objectives[k] = indv_source->penalty_objectives[k];
-    }
-    indv_dest->rank = indv_source->rank;
-    indv_dest->crowding_distance = indv_source->crowding_distance;
+    kernels.copy_individual(mcp, indv_source, indv_dest);
 }
 
 void
@@ -58,6 +63,7 @@ combine_populations(MCproblem *mcp, Population *pop1, Population *pop2, Populati
  *      1DOMINATES2 if indv1 dominates indv2
  *      2DOMINATES1 if indv2 dominates indv1
  *      NONDOMINATED if both are non dominated
+ * If mcp->epsilon_dominance is set objectives are compared by their box of side OBJ_TOL, so objectives that are not meaningfully different do not create domination.
  */
 int
 find_domination(MCproblem *mcp, Individual *indv_a, Individual *indv_b)
@@ -65,16 +71,99 @@ find_domination(MCproblem *mcp, Individual *indv_a, Individual *indv_b)
     int a_dominates_b = 1;
     int b_dominates_a = 1;
 
-    for (int i=0; i < mcp->n_models; i++){
-        if(indv_a->penalty_objectives[i] > indv_b->penalty_objectives[i])
-            b_dominates_a = 0; // can stop if a_dominates_b==0
-        if(indv_b->penalty_objectives[i] > indv_a->penalty_objectives[i])
-            a_dominates_b = 0; //can stop if 2dominates1==0
+    if (mcp->epsilon_dominance) {
+        double box_a, box_b;
+        for (int i=0; i < mcp->n_models; i++){
+            box_a = floor(indv_a->penalty_objectives[i] / OBJ_TOL);
+            box_b = floor(indv_b->penalty_objectives[i] / OBJ_TOL);
+            if(box_a > box_b)
+                b_dominates_a = 0;
+            if(box_b > box_a)
+                a_dominates_b = 0;
+        }
+        if(a_dominates_b && b_dominates_a) return NONDOMINATED;
+        if(a_dominates_b) return A_DOMINATES_B;
+        if(b_dominates_a) return B_DOMINATES_A;
+        return NONDOMINATED;
     }
-    if(a_dominates_b && b_dominates_a) return NONDOMINATED; /* both objective vectors are equal */
-    if(a_dominates_b) return A_DOMINATES_B;
-    if(b_dominates_a) return B_DOMINATES_A;
-    return NONDOMINATED;
+
+    return kernels.find_domination(mcp, indv_a, indv_b);
+}
+
+/* FNV-1a hash of the genome (deletions and, if used, modules). Never returns 0 since it marks empty slots in GenomeSet. */
+uint64_t
+genome_hash(MCproblem *mcp, Individual *indv)
+{
+    uint64_t h = 14695981039346656037ULL;
+    size_t j;
+
+    for (j=0; j < mcp->n_vars; j++) {
+        h ^= indv->deletions[j];
+        h *= 1099511628211ULL;
+    }
+    if (mcp->use_modules) {
+        for (j=0; j < mcp->n_models * mcp->n_vars; j++) {
+            h ^= indv->modules[j];
+            h *= 1099511628211ULL;
+        }
+    }
+    return h ? h : 1;
+}
+
+int
+is_same_genome(MCproblem *mcp, Individual *indv_a, Individual *indv_b)
+{
+    size_t j;
+
+    for (j=0; j < mcp->n_vars; j++)
+        if (indv_a->deletions[j] != indv_b->deletions[j])
+            return 0;
+    if (mcp->use_modules)
+        for (j=0; j < mcp->n_models * mcp->n_vars; j++)
+            if (indv_a->modules[j] != indv_b->modules[j])
+                return 0;
+    return 1;
+}
+
+/* The set stores pointers, so the individuals must not change while they are in it */
+void
+allocate_genome_set(GenomeSet *set, size_t max_size)
+{
+    for (set->capacity = 1; set->capacity < 2*max_size; set->capacity *= 2);
+    SAFE_ALLOC(set->hashes = malloc(set->capacity * sizeof *set->hashes))
+    SAFE_ALLOC(set->indvs = malloc(set->capacity * sizeof *set->indvs))
+    clear_genome_set(set);
+}
+
+void
+free_genome_set(GenomeSet *set)
+{
+    free(set->hashes);
+    free(set->indvs);
+}
+
+void
+clear_genome_set(GenomeSet *set)
+{
+    for (size_t i=0; i < set->capacity; i++)
+        set->hashes[i] = 0;
+}
+
+/* Returns 1 if indv was inserted or 0 if an identical genome is already in the set (linear probing) */
+int
+insert_genome(MCproblem *mcp, GenomeSet *set, Individual *indv)
+{
+    uint64_t h = genome_hash(mcp, indv);
+    size_t i = h & (set->capacity - 1);
+
+    while (set->hashes[i] != 0) {
+        if ((set->hashes[i] == h) && is_same_genome(mcp, set->indvs[i], indv))
+            return 0;
+        i = (i + 1) & (set->capacity - 1);
+    }
+    set->hashes[i] = h;
+    set->indvs[i] = indv;
+    return 1;
 }
 
 /* Two point binary crossover of two individuals
@@ -82,75 +171,61 @@ find_domination(MCproblem *mcp, Individual *indv_a, Individual *indv_b)
  *      - Crossover on module reactions is done on each model indepently. However, the  crossover  sites are the same that in deletions, given the relation between both variables this is a better way to preserve blocks. This is tricky since it might also be good to be able to get rid of modules.
  */
 
-#define  FILL \
-    child1->deletions[j] = parent1->deletions[j]; \
-    child2->deletions[j] = parent2->deletions[j];
+void
+crossover(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng)
+{
+    if ( (double)pcg32_boundedrand_r(rng, 100)/100 <= mcp->crossover_probability)
+        crossover_two_point(mcp, parent1, parent2, child1, child2, rng);
+    else /* No crossover is done */
+        kernels.crossover_segment(mcp, parent1, parent2, child1, child2, 0, 0);
+}
 
-#define  FILLB \
-    if (mcp->use_modules) { \
-        for (k=0; k < mcp->n_models; k++) { \
-            child1->modules[k*mcp->n_vars + j] = parent1->modules[k*mcp->n_vars + j]; \
-            child2->modules[k*mcp->n_vars + j] = parent2->modules[k*mcp->n_vars + j]; \
-        }\
+/* Two point crossover without the crossover probability check */
+void
+crossover_two_point(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng)
+{
+    int temp, site1, site2;
+
+    site1 = pcg32_boundedrand_r(rng, mcp->n_vars);
+    site2 = pcg32_boundedrand_r(rng, mcp->n_vars);
+    if (site1 > site2) { /* swap variables */
+        temp = site1;
+        site1 = site2;
+        site2 = temp;
     }
+    kernels.crossover_segment(mcp, parent1, parent2, child1, child2, site1, site2);
+}
 
+/* Uniform crossover, each site (deletion and its modules) comes from either parent with equal probability */
 void
-crossover(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2)
+crossover_uniform(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng)
 {
-    int j, k, temp, site1, site2;
-
-    if ( (double)pcg32_boundedrand(100)/100 <= mcp->crossover_probability)  {
-        site1 = pcg32_boundedrand(mcp->n_vars);
-        site2 = pcg32_boundedrand(mcp->n_vars);
-        if (site1 > site2) { /* swap variables */
-            temp = site1;
-            site1 = site2;
-            site2 = temp;
-        }
-        for (j=0; j < site1; j++) {
-            FILL
-            FILLB
-        }
-        for (j=site1; j < site2; j++){
-            child1->deletions[j] = parent2->deletions[j];
-            child2->deletions[j] = parent1->deletions[j];
-            if (mcp->use_modules) {
-                for (k=0; k < mcp->n_models; k++) {
-                    child1->modules[k*mcp->n_vars + j] = parent2->modules[k*mcp->n_vars + j];
-                    child2->modules[k*mcp->n_vars + j] = parent1->modules[k*mcp->n_vars + j];
-                }
-            }
-        }
-        for (j=site2; j < mcp->n_vars; j++){
-            FILL
-            FILLB
-        }
-    } else { /* No crossover is done */
-        for (j=0; j < mcp->n_vars; j++) {
-            FILL
-            FILLB
-        }
-    }
+    kernels.crossover_uniform(mcp, parent1, parent2, child1, child2, rng);
 }
 
 
 /* Binary mutation of individual
  *      - A random bit might be flipped in deletion array and each module reaction array independently. Flipping the same bit for deletions and all modules would be useless.
+ *      - If mcp->alpha_repair is set and the individual already has alpha or more deletions, a swap mutation is done instead of the bit flip so the number of deletions does not increase.
  */
 void
-mutation(MCproblem *mcp, Individual *indv)
+mutation(MCproblem *mcp, Individual *indv, pcg32_random_t *rng)
 {
     int k, site;
 
-    if ( (double)pcg32_boundedrand(100)/100 <= mcp->mutation_probability)  {
-        site = pcg32_boundedrand(mcp->n_vars);
-        indv->deletions[site] = !indv->deletions[site];
+    if ( (double)pcg32_boundedrand_r(rng, 100)/100 <= mcp->mutation_probability)  {
+        if (mcp->alpha_repair && (count_deletions(mcp, indv) >= mcp->alpha)) {
+            mutation_swap(mcp, indv, rng);
+        } else {
+            site = pcg32_boundedrand_r(rng, mcp->n_vars);
+            indv->deletions[site] = !indv->deletions[site];
+        }
     }
 
     if (mcp->use_modules) {
         for (k=0; k < mcp->n_models; k++) {
-            if ( (double)pcg32_boundedrand(100)/100 <= mcp->mutation_probability)  {
-                site = pcg32_boundedrand(mcp->n_vars);
+            if ( (double)pcg32_boundedrand_r(rng, 100)/100 <= mcp->mutation_probability)  {
+                site = pcg32_boundedrand_r(rng, mcp->n_vars);
                 indv->modules[k*mcp->n_vars + site] = !indv->modules[k*mcp->n_vars + site];
             }
         }
@@ -158,6 +233,64 @@ mutation(MCproblem *mcp, Individual *indv)
 }
 
 
+/* Swaps a random deleted reaction with a random non-deleted one, so the number of deletions is kept. Does nothing if there is no reaction of either kind. */
+void
+mutation_swap(MCproblem *mcp, Individual *indv, pcg32_random_t *rng)
+{
+    int j, deleted = -1, kept = -1, n_deleted = 0, n_kept = 0;
+
+    for (j=0; j < mcp->n_vars; j++) { /* Reservoir sampling of one reaction of each kind */
+        if (indv->deletions[j] == DELETED_RXN) {
+            if (pcg32_boundedrand_r(rng, ++n_deleted) == 0)
+                deleted = j;
+        }
+        else if (pcg32_boundedrand_r(rng, ++n_kept) == 0) {
+            kept = j;
+        }
+    }
+    if ((deleted == -1) || (kept == -1))
+        return;
+    indv->deletions[deleted] = !DELETED_RXN;
+    indv->deletions[kept] = DELETED_RXN;
+}
+
+
+/* Removes random deletions until the individual has at most alpha of them. Used instead of the objective penalty if mcp->alpha_repair is set. */
+void
+repair_alpha(MCproblem *mcp, Individual *indv, pcg32_random_t *rng)
+{
+    int j, i, n_deleted = 0, target;
+    int *deleted_rxns;
+
+    if (count_deletions(mcp, indv) <= mcp->alpha)
+        return;
+
+    SAFE_ALLOC(deleted_rxns = malloc(mcp->n_vars * sizeof *deleted_rxns))
+    for (j=0; j < mcp->n_vars; j++)
+        if (indv->deletions[j] == DELETED_RXN)
+            deleted_rxns[n_deleted++] = j;
+    for (i=0; i < n_deleted - (int)mcp->alpha; i++) { /* Partial Fisher-Yates shuffle, the first elements are removed */
+        target = i + pcg32_boundedrand_r(rng, n_deleted - i);
+        j = deleted_rxns[target];
+        deleted_rxns[target] = deleted_rxns[i];
+        deleted_rxns[i] = j;
+        indv->deletions[j] = !DELETED_RXN;
+    }
+    free(deleted_rxns);
+}
+
+int
+count_deletions(MCproblem *mcp, Individual *indv)
+{
+    int n_deletions = 0;
+
+    for (int j=0; j < mcp->n_vars; j++)
+        if (indv->deletions[j] == DELETED_RXN)
+            n_deletions++;
+    return n_deletions;
+}
+
+
 /* After crossover and mutation are done, they may generate individuals that violate the two module reaction related constraints. This method enforces both constraints as follows:
  *       1. Removes modules that are not deletions
  *       2. If number of modules is above limit (beta), randomly removes modules until within limit.
@@ -166,7 +299,7 @@ mutation(MCproblem *mcp, Individual *indv)
  *      - pcg32 does not provide a method to obtain a list of non-repeated random numbers.
  */
 void
-enforce_module_constraints(MCproblem *mcp, Individual *indv)
+enforce_module_constraints(MCproblem *mcp, Individual *indv, pcg32_random_t *rng)
 {
     int i, j, k, n_module_rxn, module_diff, n_removed_module, target;
     int module_rxn_idx[MAX_MODULES] = {-1}, is_removed_module[MAX_MODULES] = {-1};
@@ -196,7 +329,7 @@ enforce_module_constraints(MCproblem *mcp, Individual *indv)
                 is_removed_module[i] = 0;
             n_removed_module = 0;
             while (module_diff != n_removed_module) {
-                target = pcg32_boundedrand(module_diff);
+                target = pcg32_boundedrand_r(rng, module_diff);
                 if (is_removed_module[target] == 0) {
                     is_removed_module[target] = 1;
                     n_removed_module++;
@@ -207,6 +340,24 @@ enforce_module_constraints(MCproblem *mcp, Individual *indv)
     }
 }
 
+/* Seeds rng with a stream that only depends on the run seed, the MPI rank, and the round (e.g., generation) and index (e.g., individual) it is used for. Operators that draw from their own stream give the same results regardless of the order (or thread) in which individuals are processed.
+ * Notes:
+ *      - The stream selector is a splitmix64 hash of (rank, round, index), so nearby ids give unrelated streams.
+ */
+void
+set_rng_stream(MCproblem *mcp, pcg32_random_t *rng, unsigned int round, unsigned int index)
+{
+    uint64_t ids[3] = {(uint64_t)mpi_pe, round, index}, h = 0;
+
+    for (int i=0; i < 3; i++) {
+        h += ids[i] + 0x9e3779b97f4a7c15ULL;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+    }
+    pcg32_srandom_r(rng, mcp->seed, h);
+}
+
 /*
  * This function will set indv->objectives and indv->penalty_objectives
  *
@@ -217,10 +368,21 @@ enforce_module_constraints(MCproblem *mcp, Individual *indv)
  */
 void
 calculate_objectives(MCproblem *mcp, Individual *indv)
+{
+    calculate_objectives_basis(mcp, indv, NULL, NULL);
+}
+
+/* Same as calculate_objectives() but each LP can be warm-started from a known basis and the final basis can be stored
+ *      - basis_in: [mcp->basis_size] Basis of all models loaded before solving (e.g., that of a similar individual), or NULL to start from the current GLPK basis.
+ *      - basis_out: [mcp->basis_size] Receives the basis of all models after solving, or NULL.
+ */
+void
+calculate_objectives_basis(MCproblem *mcp, Individual *indv, unsigned char *basis_in, unsigned char *basis_out)
 {
     LPproblem *lp;
-    int j,k,n_deletions=0;
-    int *change_bound = malloc(mcp->n_vars * sizeof(int));
+    int j,k,n_deletions=0,status;
+    int *change_bound, *hit = NULL; /* hit[k]: objective k found in the evaluation store or the fitness cache */
+    uint64_t *keys = NULL;
 
     /* Preliminary evaluation */
     for (j=0; j < mcp->n_vars; j++)
@@ -232,13 +394,42 @@ calculate_objectives(MCproblem *mcp, Individual *indv)
             lp = &(mcp->lps[k]);
             indv->objectives[k] = lp->no_deletion_objective;
             indv->penalty_objectives[k] = lp->no_deletion_objective;
+            if (basis_out) {
+                if (basis_in)
+                    load_basis(mcp, k, basis_in);
+                save_basis(mcp, k, basis_out);
+            }
         }
         return;
     }
 
+    change_bound = malloc(mcp->n_vars * sizeof(int));
+    if ((mcp->fitness_cache_mb > 0) || (mcp->eval_store_path[0] != '\0')) {
+        hit = malloc(mcp->n_models * sizeof(int));
+        keys = malloc(mcp->n_models * sizeof(uint64_t));
+        for (k=0; k < mcp->n_models; k++) {
+            keys[k] = knockout_key(mcp, indv, k, change_bound);
+            hit[k] = 0;
+        }
+        if (mcp->eval_store_path[0] != '\0')
+            eval_store_lookup(mcp, indv, keys, hit);
+        if (mcp->fitness_cache_mb > 0)
+            fitness_cache_lookup(mcp, indv, keys, hit);
+    }
+
     /* Objective calculation */
     for (k=0; k < mcp->n_models; k++) {
-        calculate_objective(mcp, indv, k, change_bound);
+        if (basis_in)
+            load_basis(mcp, k, basis_in);
+        if (!hit || !hit[k]) {
+            status = calculate_objective(mcp, indv, k, change_bound);
+            if ((mcp->fitness_cache_mb > 0) && (status == GLP_OPT))
+                fitness_cache_insert(mcp, keys[k], indv->objectives[k]);
+            if ((mcp->eval_store_path[0] != '\0') && (status == GLP_OPT))
+                eval_store_insert(mcp, keys[k], indv->objectives[k]);
+        }
+        if (basis_out)
+            save_basis(mcp, k, basis_out);
         /* Calculate penalty objectives (note that module reaction constraints are strictly enforced by genetic operators) */
         if (n_deletions > mcp->alpha)
             indv->penalty_objectives[k] = indv->objectives[k]/n_deletions;
@@ -247,6 +438,56 @@ calculate_objectives(MCproblem *mcp, Individual *indv)
     }
 
     free(change_bound);
+    free(hit);
+    free(keys);
+}
+
+/* Hash of k and the effective knockout set of indv in model k (the reactions blocked by solve_objective()), never 0. Key of the evaluation store and the fitness cache. */
+uint64_t
+knockout_key(MCproblem *mcp, Individual *indv, int k, int *change_bound)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    kernels.set_change_bound(mcp, indv, k, change_bound);
+    h = (h ^ (uint64_t)k) * 1099511628211ULL;
+    for (size_t j=0; j < mcp->n_vars; j++) {
+        if (change_bound[j]) {
+            h = (h ^ (uint64_t)j) * 1099511628211ULL;
+            h = (h ^ (uint64_t)(j >> 8)) * 1099511628211ULL;
+        }
+    }
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL; /* Spread the bits used for partitioning */
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h ? h : 1;
+}
+
+/* Stores the row and column statuses of model k into its segment of a flat basis array ([mcp->basis_size]) */
+void
+save_basis(MCproblem *mcp, int k, unsigned char *basis)
+{
+    LPproblem *lp = &(mcp->lps[k]);
+    unsigned char *b = basis + lp->basis_offset;
+    int i, n_rows = glp_get_num_rows(lp->P), n_cols = glp_get_num_cols(lp->P);
+
+    for (i=1; i <= n_rows; i++)
+        b[i-1] = (unsigned char)glp_get_row_stat(lp->P, i);
+    for (i=1; i <= n_cols; i++)
+        b[n_rows + i-1] = (unsigned char)glp_get_col_stat(lp->P, i);
+}
+
+/* Restores a basis stored by save_basis(). Statuses that are inconsistent with the current bounds are corrected by GLPK. */
+void
+load_basis(MCproblem *mcp, int k, unsigned char *basis)
+{
+    LPproblem *lp = &(mcp->lps[k]);
+    unsigned char *b = basis + lp->basis_offset;
+    int i, n_rows = glp_get_num_rows(lp->P), n_cols = glp_get_num_cols(lp->P);
+
+    for (i=1; i <= n_rows; i++)
+        glp_set_row_stat(lp->P, i, b[i-1]);
+    for (i=1; i <= n_cols; i++)
+        glp_set_col_stat(lp->P, i, b[n_rows + i-1]);
 }
 
 /*
@@ -254,23 +495,27 @@ calculate_objectives(MCproblem *mcp, Individual *indv)
  *
  * Notes:
  *      - change_bound is passed to reduce number of mallocs
+ *      - Returns the GLPK status of the solution (see solve_objective())
  */
-void calculate_objective(MCproblem *mcp, Individual *indv, int k, int *change_bound) {
+int calculate_objective(MCproblem *mcp, Individual *indv, int k, int *change_bound) {
+    int status = solve_objective(mcp, indv, k, change_bound, &param);
+
+    if (status != GLP_OPT)
+        indv->objectives[k] = 0; //TODO: Should it be set to UNKNOWN_OBJ (-1)? Is there anything that assumes positive objective values? Can help keep track of failed calc., although currently this information is not used.
+    return status;
+}
 
+/* Same as calculate_objective() with the given simplex parameters. Returns the GLPK status of the solution (0 if the solver failed), indv->objectives[k] is only set if the status is GLP_OPT or GLP_FEAS (e.g., iteration limit reached from a primal feasible basis). */
+int
+solve_objective(MCproblem *mcp, Individual *indv, int k, int *change_bound, glp_smcp *parm)
+{
     LPproblem *lp;
-    int j;
+    int j, ret, status = 0;
 
     lp = &(mcp->lps[k]);
 
-    /* Determine what bounds to change */
-    for (j=0; j < mcp->n_vars; j++) {
-        change_bound[j] = 0;
-        if ((lp->cand_col_idx[j] != NOT_CANDIDATE) && (indv->deletions[j] == DELETED_RXN)) {
-            change_bound[j] = 1; /* Reaction deleted in the chassis */
-            if(mcp->use_modules && (indv->modules[k*mcp->n_vars + j] == 1))
-                    change_bound[j] = 0; /* Reaction inserted back as module */
-        }
-    }
+    /* Determine what bounds to change (deleted in the chassis and not inserted back as module) */
+    kernels.set_change_bound(mcp, indv, k, change_bound);
 
     /* Block bounds */
     for (j=0; j < mcp->n_vars; j++)
@@ -278,13 +523,30 @@ void calculate_objective(MCproblem *mcp, Individual *indv, int k, int *change_bo
 	    glp_set_col_bnds(lp->P, lp->cand_col_idx[j], GLP_FX, 0, 0);
 
     /* Calculate objectives */
-    if ((glp_simplex(lp->P, &param) == 0) && (glp_get_status(lp->P) == GLP_OPT)) /* Problem solved succesfully and solution status is optimal */
+    ret = glp_simplex(lp->P, parm);
+    if ((ret == 0) || (ret == GLP_EITLIM) || (ret == GLP_ETMLIM))
+        status = glp_get_status(lp->P);
+    if ((status == GLP_OPT) || (status == GLP_FEAS))
         indv->objectives[k] = glp_get_col_prim(lp->P, lp->prod_col_idx)/lp->max_prod_growth;
-    else
-        indv->objectives[k] = 0; //TODO: Should it be set to UNKNOWN_OBJ (-1)? Is there anything that assumes positive objective values? Can help keep track of failed calc., although currently this information is not used.
 
     /* Reset bounds */
     for (j=0; j < mcp->n_vars; j++)
         if(change_bound[j])
 	    glp_set_col_bnds(lp->P, lp->cand_col_idx[j], lp->cand_col_type[j], lp->cand_og_lb[j], lp->cand_og_ub[j]);
+
+    return status;
+}
+
+/* Sets penalty_objectives from objectives (see calculate_objectives_basis()) */
+void
+set_penalty_objectives(MCproblem *mcp, Individual *indv)
+{
+    int k, n_deletions = count_deletions(mcp, indv);
+
+    for (k=0; k < mcp->n_models; k++) {
+        if ((n_deletions > mcp->alpha) && (indv->objectives[k] != UNKNOWN_OBJ))
+            indv->penalty_objectives[k] = indv->objectives[k]/n_deletions;
+        else
+            indv->penalty_objectives[k] = indv->objectives[k];
+    }
 }
@@ -0,0 +1,190 @@
+/* Probabilistic model of promising genes, in the spirit of estimation of distribution algorithms. The model holds the deletion frequency of each reaction and the module frequency of each reaction in each model among the non-dominated individuals of the population, and it is used to pick the sites of mutations and the deletions of new individuals.
+ * Notes:
+ *      - A fraction exploration_floor of the probability mass is spread uniformly over all reactions, so reactions absent from the front can still be sampled.
+ *      - Sites are sampled by binary search over cumulative distributions, which are rebuilt on each update.
+ *      - Mutation flips the sampled site, so, as with uniform mutation, reactions deleted in the individual can also be recovered.
+ *      - New individuals get alpha distinct deletions outside the blacklist (see seeding.c). After MAX_MODEL_DRAWS rejected draws a deletion is drawn uniformly instead, since the model may put little mass on the allowed reactions.
+ */
+
+#include <stdlib.h>
+#include "modcell.h"
+
+#define MAX_MODEL_DRAWS 100 	/* Rejected model draws before a deletion of a new individual is drawn uniformly */
+
+void gene_model_init(MCproblem *mcp);
+void gene_model_free(void);
+void gene_model_update(MCproblem *mcp, Population *pop, size_t n_indv, int front_only);
+void gene_model_mutation(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+void set_gene_model_individual(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+int gene_model_site(MCproblem *mcp, pcg32_random_t *rng);
+static int sample_site(MCproblem *mcp, double *cumulative, pcg32_random_t *rng);
+static void set_cumulative(MCproblem *mcp, double *counts, double *cumulative);
+
+/* Globals */
+static double *deletion_cumulative; /* [n_vars] */
+static double *module_cumulative; /* [n_models*n_vars] */
+static double *counts; /* [n_vars] */
+
+void
+gene_model_init(MCproblem *mcp)
+{
+    int j, k;
+
+    SAFE_ALLOC(deletion_cumulative = malloc(mcp->n_vars * sizeof *deletion_cumulative))
+    SAFE_ALLOC(counts = malloc(mcp->n_vars * sizeof *counts))
+    if (mcp->use_modules)
+        SAFE_ALLOC(module_cumulative = malloc(mcp->n_models * mcp->n_vars * sizeof *module_cumulative))
+
+    /* Uniform until the first update */
+    for (j=0; j < mcp->n_vars; j++)
+        counts[j] = 0;
+    set_cumulative(mcp, counts, deletion_cumulative);
+    if (mcp->use_modules)
+        for (k=0; k < mcp->n_models; k++)
+            set_cumulative(mcp, counts, &(module_cumulative[k*mcp->n_vars]));
+}
+
+void
+gene_model_free(void)
+{
+    free(deletion_cumulative);
+    free(counts);
+    free(module_cumulative);
+}
+
+/* Rebuilds the model from the first n_indv individuals of pop. If front_only is set only those with rank 1 are used. */
+void
+gene_model_update(MCproblem *mcp, Population *pop, size_t n_indv, int front_only)
+{
+    size_t i;
+    int j, k;
+    Individual *indv;
+
+    for (j=0; j < mcp->n_vars; j++)
+        counts[j] = 0;
+    for (i=0; i < n_indv; i++) {
+        indv = &(pop->indv[i]);
+        if (front_only && (indv->rank != 1))
+            continue;
+        for (j=0; j < mcp->n_vars; j++)
+            if (indv->deletions[j] == DELETED_RXN)
+                counts[j]++;
+    }
+    set_cumulative(mcp, counts, deletion_cumulative);
+
+    if (mcp->use_modules) {
+        for (k=0; k < mcp->n_models; k++) {
+            for (j=0; j < mcp->n_vars; j++)
+                counts[j] = 0;
+            for (i=0; i < n_indv; i++) {
+                indv = &(pop->indv[i]);
+                if (front_only && (indv->rank != 1))
+                    continue;
+                for (j=0; j < mcp->n_vars; j++)
+                    if (indv->modules[k*mcp->n_vars + j] == MODULE_RXN)
+                        counts[j]++;
+            }
+            set_cumulative(mcp, counts, &(module_cumulative[k*mcp->n_vars]));
+        }
+    }
+}
+
+/* Mixes the normalized counts with the uniform distribution (weight exploration_floor) */
+static void
+set_cumulative(MCproblem *mcp, double *counts, double *cumulative)
+{
+    int j;
+    double total = 0, sum = 0, floor = mcp->exploration_floor;
+
+    for (j=0; j < mcp->n_vars; j++)
+        total += counts[j];
+    if (total == 0)
+        floor = 1;
+    for (j=0; j < mcp->n_vars; j++) {
+        sum += floor/mcp->n_vars + ((total > 0) ? (1 - floor)*counts[j]/total : 0);
+        cumulative[j] = sum;
+    }
+    cumulative[mcp->n_vars - 1] = 1; /* Avoid rounding errors */
+}
+
+static int
+sample_site(MCproblem *mcp, double *cumulative, pcg32_random_t *rng)
+{
+    double r = (double)pcg32_random_r(rng) / 4294967296.0;
+    int low = 0, high = mcp->n_vars - 1, mid;
+
+    while (low < high) {
+        mid = (low + high)/2;
+        if (cumulative[mid] > r)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
+int
+gene_model_site(MCproblem *mcp, pcg32_random_t *rng)
+{
+    return sample_site(mcp, deletion_cumulative, rng);
+}
+
+/* Same as mutation() but sites are sampled from the model */
+void
+gene_model_mutation(MCproblem *mcp, Individual *indv, pcg32_random_t *rng)
+{
+    int k, site;
+
+    if ( (double)pcg32_boundedrand_r(rng, 100)/100 <= mcp->mutation_probability)  {
+        site = sample_site(mcp, deletion_cumulative, rng);
+        indv->deletions[site] = !indv->deletions[site];
+    }
+
+    if (mcp->use_modules) {
+        for (k=0; k < mcp->n_models; k++) {
+            if ( (double)pcg32_boundedrand_r(rng, 100)/100 <= mcp->mutation_probability)  {
+                site = sample_site(mcp, &(module_cumulative[k*mcp->n_vars]), rng);
+                indv->modules[k*mcp->n_vars + site] = !indv->modules[k*mcp->n_vars + site];
+            }
+        }
+    }
+}
+
+/* Same as set_random_individual() but deletions are sampled from the model, without repetition, and, in each model, the deleted reaction most likely to be a module is inserted back */
+void
+set_gene_model_individual(MCproblem *mcp, Individual *indv, pcg32_random_t *rng)
+{
+    int i, j, k, best, n_draws;
+    double p, best_p;
+    int *deleted_rxns;
+    SAFE_ALLOC(deleted_rxns = malloc(mcp->alpha * sizeof *deleted_rxns))
+
+    for (j = 0; j < mcp->n_vars; j++)
+        indv->deletions[j] = !DELETED_RXN;
+    for (i = 0; i < mcp->alpha; i++) {
+        n_draws = 0;
+        do
+            deleted_rxns[i] = (n_draws++ < MAX_MODEL_DRAWS) ? sample_site(mcp, deletion_cumulative, rng) : (int)pcg32_boundedrand_r(rng, mcp->n_vars);
+        while (((mcp->blacklist != NULL) && mcp->blacklist[deleted_rxns[i]]) || (indv->deletions[deleted_rxns[i]] == DELETED_RXN));
+        indv->deletions[deleted_rxns[i]] = DELETED_RXN;
+    }
+    if (mcp->use_modules) {
+        for (k = 0; k < mcp->n_models; k++) {
+            for (j = 0; j < mcp->n_vars; j++)
+                indv->modules[k*mcp->n_vars + j] = !MODULE_RXN;
+            best = 0;
+            best_p = -1;
+            for (i = 0; i < mcp->alpha; i++) {
+                j = deleted_rxns[i];
+                p = module_cumulative[k*mcp->n_vars + j] - ((j > 0) ? module_cumulative[k*mcp->n_vars + j - 1] : 0);
+                if (p > best_p) {
+                    best = j;
+                    best_p = p;
+                }
+            }
+            indv->modules[k*mcp->n_vars + best] = MODULE_RXN;
+        }
+    }
+    calculate_objectives(mcp, indv);
+    free(deleted_rxns);
+}
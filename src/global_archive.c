@@ -0,0 +1,476 @@
+/* Global Pareto archive of all islands. Every global_archive_interval generations each island sends its non-dominated individuals to PE 0, which keeps the non-dominated designs received from all islands and writes them to OUTPUT_FILE at the end of the run, so the island populations do not need to be merged and filtered afterwards.
+ * Notes:
+ *      - Contributions are non-blocking sends on a duplicated communicator and an island skips a contribution while its previous one is pending, so islands never wait for PE 0. PE 0 absorbs the contributions that have arrived every generation, its own follow the same path.
+ *      - At the end each island sends a final contribution and PE 0 absorbs until it has the final contribution of every island, so islands may finish at different times. This must happen before any blocking collective of the run end.
+ *      - Dominance uses penalty_objectives, as the MOEA does. A design with the same penalty objectives as an archive member is discarded.
+ *      - The members are kept in an ND-tree (Jaszkiewicz and Lust, 2018). Each node stores the ideal and nadir points of the members below it, so a new design is rejected as soon as a nadir weakly dominates it, whole subtrees are removed if it weakly dominates their ideal, and subtrees whose box it neither is dominated by nor dominates are skipped. Leaves hold up to ND_LEAF_SIZE members and are split in ND_CHILDREN leaves around mutually distant members. Bounds are not tightened after removals, they only become looser.
+ *      - Module reactions are kept if any island uses them, even if PE 0 does not.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "modcell.h"
+
+#define GLOBAL_ARCHIVE_TAG 2
+#define ND_LEAF_SIZE 20
+#define ND_CHILDREN 6
+#define FRONT_INITIAL_CAPACITY 256
+
+extern int mpi_pe, mpi_comm_size;
+
+typedef struct NDNode {
+	double *ideal; 		/* [n_models] Component-wise best of the members below the node */
+	double *nadir; 		/* [n_models] Component-wise worst of the members below the node */
+	int members[ND_LEAF_SIZE + 1]; /* Indices in front.indv, leaves only */
+	int n_members;
+	struct NDNode *children[ND_CHILDREN];
+	int n_children; 	/* 0 for leaves */
+} NDNode;
+
+void global_archive_init(MCproblem *mcp);
+void global_archive_free(MCproblem *mcp);
+void global_archive_contribute(MCproblem *mcp, Population *pop);
+void global_archive_poll(MCproblem *mcp);
+void global_archive_finalize(MCproblem *mcp, Population *pop);
+void global_archive_print(MCproblem *mcp);
+static int pack_front(MCproblem *mcp, Population *pop, int final);
+static int absorb(char *buffer, int size);
+static int weakly_dominates(double *a, double *b);
+static NDNode * new_node(void);
+static void free_node(NDNode *node);
+static void clear_node(NDNode *node);
+static int update_node(NDNode *node, double *y);
+static void insert(NDNode *node, int member);
+static void split(NDNode *node);
+static double midpoint_distance(NDNode *node, double *y);
+
+/* Globals */
+static MCproblem front_mcp; 	/* Problem of the members, use_modules is set if any island uses modules */
+static int n_obj;
+static MPI_Comm archive_comm;
+static MPI_Request send_request;
+static char *send_buffer, *recv_buffer;
+static int buffer_size, recv_size;
+static bool *in_front; 		/* [population_size] */
+static int *deleted_rxns; 	/* [n_vars] */
+static bool *module_flags; 	/* [n_vars] */
+static Population front; 	/* front.size is the capacity, free slots have rank -1 */
+static int *free_slots, n_free;
+static Individual candidate; 	/* Last received design */
+static NDNode *root;
+static int n_final; 		/* Islands whose final contribution has been absorbed */
+static unsigned long n_received;
+
+void
+global_archive_init(MCproblem *mcp)
+{
+    int size, any_modules;
+
+    MPI_Comm_dup(MPI_COMM_WORLD, &archive_comm);
+    MPI_Allreduce(&(mcp->use_modules), &any_modules, 1, MPI_INT, MPI_MAX, archive_comm);
+    front_mcp = *mcp;
+    front_mcp.use_modules = any_modules;
+    n_obj = mcp->n_models;
+
+    /* Upper bound of the packed size of a contribution */
+    MPI_Pack_size(3, MPI_INT, archive_comm, &buffer_size);
+    MPI_Pack_size(1 + mcp->n_vars, MPI_INT, archive_comm, &size);
+    buffer_size += mcp->population_size * size;
+    MPI_Pack_size(2*mcp->n_models, MPI_DOUBLE, archive_comm, &size);
+    buffer_size += mcp->population_size * size;
+    if (mcp->use_modules) {
+        MPI_Pack_size(mcp->n_vars, MPI_C_BOOL, archive_comm, &size);
+        buffer_size += mcp->population_size * mcp->n_models * size;
+    }
+    SAFE_ALLOC(send_buffer = malloc(buffer_size))
+    SAFE_ALLOC(in_front = malloc(mcp->population_size * sizeof *in_front))
+    SAFE_ALLOC(deleted_rxns = malloc(mcp->n_vars * sizeof *deleted_rxns))
+    SAFE_ALLOC(module_flags = malloc(mcp->n_vars * sizeof *module_flags))
+    send_request = MPI_REQUEST_NULL;
+
+    if (mpi_pe == 0) {
+        recv_size = buffer_size;
+        SAFE_ALLOC(recv_buffer = malloc(recv_size))
+        allocate_population(&front_mcp, &front, FRONT_INITIAL_CAPACITY);
+        SAFE_ALLOC(free_slots = malloc(front.size * sizeof *free_slots))
+        for (n_free=0; n_free < front.size; n_free++) {
+            free_slots[n_free] = front.size - 1 - n_free;
+            front.indv[free_slots[n_free]].rank = -1;
+        }
+        allocate_individual(&front_mcp, &candidate);
+        root = new_node();
+        n_final = 0;
+        n_received = 0;
+    }
+}
+
+void
+global_archive_free(MCproblem *mcp)
+{
+    free(send_buffer);
+    free(in_front);
+    free(deleted_rxns);
+    free(module_flags);
+    if (mpi_pe == 0) {
+        free(recv_buffer);
+        free_population(&front_mcp, &front);
+        free(free_slots);
+        free_individual(&front_mcp, &candidate);
+        free_node(root);
+    }
+    MPI_Comm_free(&archive_comm);
+}
+
+/* Sends the non-dominated individuals of pop to PE 0, unless the previous contribution is still pending */
+void
+global_archive_contribute(MCproblem *mcp, Population *pop)
+{
+    int done, size;
+
+    MPI_Test(&send_request, &done, MPI_STATUS_IGNORE);
+    if (!done)
+        return;
+    size = pack_front(mcp, pop, 0);
+    MPI_Isend(send_buffer, size, MPI_PACKED, 0, GLOBAL_ARCHIVE_TAG, archive_comm, &send_request);
+}
+
+/* PE 0 only: absorbs the contributions that have arrived */
+void
+global_archive_poll(MCproblem *mcp)
+{
+    int flag, size;
+    MPI_Status status;
+
+    if (mpi_pe != 0)
+        return;
+    for (;;) {
+        MPI_Iprobe(MPI_ANY_SOURCE, GLOBAL_ARCHIVE_TAG, archive_comm, &flag, &status);
+        if (!flag)
+            break;
+        MPI_Get_count(&status, MPI_PACKED, &size);
+        if (size > recv_size) { /* Islands may have larger populations than PE 0 */
+            recv_size = size;
+            SAFE_ALLOC(recv_buffer = realloc(recv_buffer, recv_size))
+        }
+        MPI_Recv(recv_buffer, size, MPI_PACKED, status.MPI_SOURCE, GLOBAL_ARCHIVE_TAG, archive_comm, MPI_STATUS_IGNORE);
+        n_final += absorb(recv_buffer, size);
+    }
+}
+
+/* Sends the final contribution of the island, PE 0 also waits for those of all islands and writes the archive */
+void
+global_archive_finalize(MCproblem *mcp, Population *pop)
+{
+    int i, size, done = 0;
+    Population out;
+
+    while (!done) { /* PE 0 may be sending to itself */
+        MPI_Test(&send_request, &done, MPI_STATUS_IGNORE);
+        global_archive_poll(mcp);
+    }
+    size = pack_front(mcp, pop, 1);
+    MPI_Isend(send_buffer, size, MPI_PACKED, 0, GLOBAL_ARCHIVE_TAG, archive_comm, &send_request);
+    if (mpi_pe == 0) {
+        while (n_final < mpi_comm_size)
+            global_archive_poll(mcp);
+        out.size = 0;
+        SAFE_ALLOC(out.indv = malloc((front.size - n_free + 1) * sizeof *out.indv))
+        for (i=0; i < front.size; i++)
+            if (front.indv[i].rank != -1)
+                out.indv[out.size++] = front.indv[i]; /* Shallow copy */
+        printf("Global archive: %lu designs received, %zu non-dominated\n", n_received, out.size);
+        write_population(&front_mcp, &out, mcp->global_archive_path);
+        free(out.indv);
+    }
+    MPI_Wait(&send_request, MPI_STATUS_IGNORE);
+}
+
+void
+global_archive_print(MCproblem *mcp)
+{
+    if (mpi_pe == 0)
+        printf("PE: 0\t Global archive:%zu\t Received:%lu\n", front.size - n_free, n_received);
+}
+
+/* Packs the individuals of pop not weakly dominated by another one (the first of equal ones is kept), returns the packed size */
+static int
+pack_front(MCproblem *mcp, Population *pop, int final)
+{
+    int i, i2, j, k, n_deleted, n_front = 0, position = 0;
+    Individual *indv;
+
+    for (i=0; i < pop->size; i++) {
+        in_front[i] = 1;
+        for (i2=0; (i2 < pop->size) && in_front[i]; i2++)
+            if ((i2 != i) && weakly_dominates(pop->indv[i2].penalty_objectives, pop->indv[i].penalty_objectives) &&
+                    ((i2 < i) || !weakly_dominates(pop->indv[i].penalty_objectives, pop->indv[i2].penalty_objectives)))
+                in_front[i] = 0;
+        n_front += in_front[i];
+    }
+
+    MPI_Pack(&n_front, 1, MPI_INT, send_buffer, buffer_size, &position, archive_comm);
+    MPI_Pack(&final, 1, MPI_INT, send_buffer, buffer_size, &position, archive_comm);
+    MPI_Pack(&(mcp->use_modules), 1, MPI_INT, send_buffer, buffer_size, &position, archive_comm);
+    for (i=0; i < pop->size; i++) {
+        if (!in_front[i])
+            continue;
+        indv = &(pop->indv[i]);
+        n_deleted = 0;
+        for (j=0; j < mcp->n_vars; j++)
+            if (indv->deletions[j] == DELETED_RXN)
+                deleted_rxns[n_deleted++] = j;
+        MPI_Pack(&n_deleted, 1, MPI_INT, send_buffer, buffer_size, &position, archive_comm);
+        MPI_Pack(deleted_rxns, n_deleted, MPI_INT, send_buffer, buffer_size, &position, archive_comm);
+        MPI_Pack(indv->objectives, mcp->n_models, MPI_DOUBLE, send_buffer, buffer_size, &position, archive_comm);
+        MPI_Pack(indv->penalty_objectives, mcp->n_models, MPI_DOUBLE, send_buffer, buffer_size, &position, archive_comm);
+        if (mcp->use_modules) {
+            for (k=0; k < mcp->n_models; k++) {
+                for (j=0; j < n_deleted; j++)
+                    module_flags[j] = (indv->modules[k*mcp->n_vars + deleted_rxns[j]] == MODULE_RXN);
+                MPI_Pack(module_flags, n_deleted, MPI_C_BOOL, send_buffer, buffer_size, &position, archive_comm);
+            }
+        }
+    }
+    return position;
+}
+
+/* Offers the designs of a contribution to the archive, returns 1 if it was a final contribution */
+static int
+absorb(char *buffer, int size)
+{
+    int i, j, k, n, final, has_modules, n_deleted, position = 0, slot;
+    Individual tmp;
+
+    MPI_Unpack(buffer, size, &position, &n, 1, MPI_INT, archive_comm);
+    MPI_Unpack(buffer, size, &position, &final, 1, MPI_INT, archive_comm);
+    MPI_Unpack(buffer, size, &position, &has_modules, 1, MPI_INT, archive_comm);
+    for (i=0; i < n; i++) {
+        set_blank_individual(&front_mcp, &candidate);
+        MPI_Unpack(buffer, size, &position, &n_deleted, 1, MPI_INT, archive_comm);
+        MPI_Unpack(buffer, size, &position, deleted_rxns, n_deleted, MPI_INT, archive_comm);
+        for (j=0; j < n_deleted; j++)
+            candidate.deletions[deleted_rxns[j]] = DELETED_RXN;
+        MPI_Unpack(buffer, size, &position, candidate.objectives, n_obj, MPI_DOUBLE, archive_comm);
+        MPI_Unpack(buffer, size, &position, candidate.penalty_objectives, n_obj, MPI_DOUBLE, archive_comm);
+        if (has_modules) { /* front_mcp.use_modules is set too */
+            for (k=0; k < n_obj; k++) {
+                MPI_Unpack(buffer, size, &position, module_flags, n_deleted, MPI_C_BOOL, archive_comm);
+                for (j=0; j < n_deleted; j++)
+                    if (module_flags[j])
+                        candidate.modules[k*front_mcp.n_vars + deleted_rxns[j]] = MODULE_RXN;
+            }
+        }
+        n_received++;
+
+        if (!update_node(root, candidate.penalty_objectives))
+            continue;
+        if (n_free == 0) {
+            SAFE_ALLOC(front.indv = realloc(front.indv, 2*front.size * sizeof *front.indv))
+            SAFE_ALLOC(free_slots = realloc(free_slots, 2*front.size * sizeof *free_slots))
+            for (j=2*front.size - 1; j >= (int)front.size; j--) {
+                allocate_individual(&front_mcp, &(front.indv[j]));
+                front.indv[j].rank = -1;
+                free_slots[n_free++] = j;
+            }
+            front.size *= 2;
+        }
+        slot = free_slots[--n_free];
+        tmp = front.indv[slot]; /* Swapped to avoid copying */
+        front.indv[slot] = candidate;
+        candidate = tmp;
+        front.indv[slot].rank = 0;
+        insert(root, slot);
+    }
+    return final;
+}
+
+/* Maximization */
+static int
+weakly_dominates(double *a, double *b)
+{
+    for (int k=0; k < n_obj; k++)
+        if (b[k] > a[k])
+            return 0;
+    return 1;
+}
+
+static NDNode *
+new_node(void)
+{
+    NDNode *node;
+
+    SAFE_ALLOC(node = malloc(sizeof *node))
+    SAFE_ALLOC(node->ideal = malloc(n_obj * sizeof *node->ideal))
+    SAFE_ALLOC(node->nadir = malloc(n_obj * sizeof *node->nadir))
+    node->n_members = 0;
+    node->n_children = 0;
+    return node;
+}
+
+static void
+free_node(NDNode *node)
+{
+    for (int c=0; c < node->n_children; c++)
+        free_node(node->children[c]);
+    free(node->ideal);
+    free(node->nadir);
+    free(node);
+}
+
+/* Releases all members below the node, which becomes an empty leaf */
+static void
+clear_node(NDNode *node)
+{
+    int c, m;
+
+    for (m=0; m < node->n_members; m++) {
+        front.indv[node->members[m]].rank = -1;
+        free_slots[n_free++] = node->members[m];
+    }
+    for (c=0; c < node->n_children; c++) {
+        clear_node(node->children[c]);
+        free_node(node->children[c]);
+    }
+    node->n_members = 0;
+    node->n_children = 0;
+}
+
+/* Removes the members below the node weakly dominated by y, returns 0 if y is weakly dominated by a member */
+static int
+update_node(NDNode *node, double *y)
+{
+    int c, m;
+
+    if ((node->n_members == 0) && (node->n_children == 0))
+        return 1;
+    if (weakly_dominates(node->nadir, y))
+        return 0;
+    if (weakly_dominates(y, node->ideal)) {
+        clear_node(node);
+        return 1;
+    }
+    if (!weakly_dominates(node->ideal, y) && !weakly_dominates(y, node->nadir)) /* No member can be related to y */
+        return 1;
+
+    if (node->n_children == 0) {
+        for (m=0; m < node->n_members; ) {
+            if (weakly_dominates(front.indv[node->members[m]].penalty_objectives, y))
+                return 0;
+            if (weakly_dominates(y, front.indv[node->members[m]].penalty_objectives)) {
+                front.indv[node->members[m]].rank = -1;
+                free_slots[n_free++] = node->members[m];
+                node->members[m] = node->members[--node->n_members];
+            }
+            else
+                m++;
+        }
+        return 1;
+    }
+
+    for (c=0; c < node->n_children; c++)
+        if (!update_node(node->children[c], y))
+            return 0;
+    for (c=0; c < node->n_children; ) { /* Drop emptied children */
+        if ((node->children[c]->n_members == 0) && (node->children[c]->n_children == 0)) {
+            free_node(node->children[c]);
+            node->children[c] = node->children[--node->n_children];
+        }
+        else
+            c++;
+    }
+    return 1;
+}
+
+/* Inserts a member not related by dominance to any other, in the leaf whose box midpoint is closest */
+static void
+insert(NDNode *node, int member)
+{
+    int c, best, k;
+    double *y = front.indv[member].penalty_objectives, d, best_d;
+
+    if ((node->n_members == 0) && (node->n_children == 0)) {
+        for (k=0; k < n_obj; k++)
+            node->ideal[k] = node->nadir[k] = y[k];
+    }
+    else {
+        for (k=0; k < n_obj; k++) {
+            node->ideal[k] = fmax(node->ideal[k], y[k]);
+            node->nadir[k] = fmin(node->nadir[k], y[k]);
+        }
+    }
+
+    if (node->n_children == 0) {
+        node->members[node->n_members++] = member;
+        if (node->n_members > ND_LEAF_SIZE)
+            split(node);
+        return;
+    }
+    best = 0;
+    best_d = INF;
+    for (c=0; c < node->n_children; c++) {
+        d = midpoint_distance(node->children[c], y);
+        if (d < best_d) {
+            best_d = d;
+            best = c;
+        }
+    }
+    insert(node->children[best], member);
+}
+
+/* The first seed is the member farthest from the others on average, the next ones the farthest from the seeds so far. The other members go to the closest child. */
+static void
+split(NDNode *node)
+{
+    int c, m, m2, best, k, n_members = node->n_members, members[ND_LEAF_SIZE + 1], seeded[ND_LEAF_SIZE + 1];
+    double d, d_seed, best_d, *y;
+
+    for (m=0; m < n_members; m++) {
+        members[m] = node->members[m];
+        seeded[m] = 0;
+    }
+    node->n_members = 0;
+
+    for (c=0; c < ND_CHILDREN; c++) {
+        best = 0;
+        best_d = -1;
+        for (m=0; m < n_members; m++) {
+            if (seeded[m])
+                continue;
+            y = front.indv[members[m]].penalty_objectives;
+            if (c == 0) {
+                for (m2=0, d=0; m2 < n_members; m2++)
+                    for (k=0; k < n_obj; k++)
+                        d += (y[k] - front.indv[members[m2]].penalty_objectives[k]) * (y[k] - front.indv[members[m2]].penalty_objectives[k]);
+            }
+            else {
+                for (m2=0, d=INF; m2 < c; m2++) {
+                    d_seed = midpoint_distance(node->children[m2], y);
+                    d = fmin(d, d_seed*d_seed);
+                }
+            }
+            if (d > best_d) {
+                best_d = d;
+                best = m;
+            }
+        }
+        node->children[c] = new_node();
+        node->n_children++;
+        seeded[best] = 1;
+        insert(node->children[c], members[best]);
+    }
+    for (m=0; m < n_members; m++)
+        if (!seeded[m])
+            insert(node, members[m]); /* Bounds of node already include the member */
+}
+
+static double
+midpoint_distance(NDNode *node, double *y)
+{
+    double d = 0, v;
+
+    for (int k=0; k < n_obj; k++) {
+        v = (node->ideal[k] + node->nadir[k])/2 - y[k];
+        d += v*v;
+    }
+    return sqrt(d);
+}
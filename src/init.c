@@ -9,7 +9,7 @@ void free_population(MCproblem *mcp, Population *pop);
 void free_individual(MCproblem *mcp, Individual *indv);
 
 void set_random_population(MCproblem *mcp, Population *pop);
-void set_random_individual(MCproblem *mcp,  Individual *indv);
+void set_random_individual(MCproblem *mcp,  Individual *indv, pcg32_random_t *rng);
 void set_blank_population(MCproblem *mcp, Population *pop);
 void set_blank_individual(MCproblem *mcp,  Individual *indv);
 
@@ -53,6 +53,8 @@ allocate_individual(MCproblem *mcp,  Individual *indv)
         indv->modules = malloc(mcp->n_models * mcp->n_vars * sizeof(indv->modules));
     indv->objectives = malloc(mcp->n_models * sizeof(indv->objectives));
     indv->penalty_objectives = malloc(mcp->n_models * sizeof(indv->penalty_objectives));
+    indv->rank = 0;
+    indv->operators = NO_OPERATORS;
 }
 
 
@@ -78,7 +80,7 @@ free_individual(MCproblem *mcp, Individual *indv)
 
 /* Sets individual variables randomly while  meeting constraints  */
 void
-set_random_individual(MCproblem *mcp,  Individual *indv)
+set_random_individual(MCproblem *mcp,  Individual *indv, pcg32_random_t *rng)
 {
     int i,j,k;
     int *deleted_rxns;
@@ -88,7 +90,9 @@ set_random_individual(MCproblem *mcp,  Individual *indv)
     for (j = 0; j < mcp->n_vars; j++)
         indv->deletions[j] = !DELETED_RXN;
     for (i = 0; i < mcp->alpha; i++) {
-        deleted_rxns[i] = (int)pcg32_boundedrand(mcp->n_vars);
+        do
+            deleted_rxns[i] = (int)pcg32_boundedrand_r(rng, mcp->n_vars);
+        while ((mcp->blacklist != NULL) && mcp->blacklist[deleted_rxns[i]]);
         indv->deletions[deleted_rxns[i]] = DELETED_RXN;
     }
     /* init modules. Only one module reaction is inserted regardless of beta, this heuristic leads to better individuals */
@@ -96,7 +100,7 @@ set_random_individual(MCproblem *mcp,  Individual *indv)
         for (k = 0; k < mcp->n_models; k++) {
             for (j = 0; j < mcp->n_vars; j++)
                     indv->modules[k*mcp->n_vars + j] = !MODULE_RXN;
-            indv->modules[k*mcp->n_vars + deleted_rxns[(int)pcg32_boundedrand(mcp->alpha)]] = MODULE_RXN;
+            indv->modules[k*mcp->n_vars + deleted_rxns[(int)pcg32_boundedrand_r(rng, mcp->alpha)]] = MODULE_RXN;
         }
      }
     calculate_objectives(mcp, indv);
@@ -121,14 +125,19 @@ set_blank_individual(MCproblem *mcp,  Individual *indv)
         indv->objectives[k] = UNKNOWN_OBJ;
         indv->penalty_objectives[k] = UNKNOWN_OBJ;
     }
+    indv->operators = NO_OPERATORS;
 }
 
 
 void
 set_random_population(MCproblem *mcp, Population *pop)
 {
-    for (int i=0; i < pop->size; i++)
-        set_random_individual(mcp, &(pop->indv[i]));
+    pcg32_random_t rng;
+
+    for (int i=0; i < pop->size; i++) {
+        set_rng_stream(mcp, &rng, INIT_RNG_ROUND, i);
+        set_random_individual(mcp, &(pop->indv[i]), &rng);
+    }
 }
 
 void
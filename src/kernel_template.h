@@ -0,0 +1,115 @@
+/* Template of the specialized kernels, included by kernels.c once per variant with the following defined:
+ *      - KERNEL_SUFFIX: Suffix of the function names of the variant.
+ *      - KERNEL_MODULES: 1 if module reactions are used, 0 otherwise.
+ *      - KERNEL_N_MODELS: Number of models, or 0 to use mcp->n_models.
+ * Notes:
+ *      - The kernels implement the functions of the same name in functions.c (see there for their description), with module checks resolved and, for a fixed number of models, loops over models with constant bounds, so the compiler can drop branches and unroll.
+ */
+
+#define N_MODELS (KERNEL_N_MODELS ? KERNEL_N_MODELS : (int)mcp->n_models)
+
+static void
+KERNEL(copy_genome)(MCproblem *mcp, Individual *indv_source, Individual *indv_dest)
+{
+    int j, k;
+
+    for (j=0; j < mcp->n_vars; j++)
+        indv_dest->deletions[j] = indv_source->deletions[j];
+    if (KERNEL_MODULES)
+        for (k=0; k < N_MODELS; k++)
+            for (j=0; j < mcp->n_vars; j++)
+                indv_dest->modules[k*mcp->n_vars + j] = indv_source->modules[k*mcp->n_vars + j];
+}
+
+static void
+KERNEL(copy_individual)(MCproblem *mcp, Individual *indv_source, Individual *indv_dest)
+{
+    KERNEL(copy_genome)(mcp, indv_source, indv_dest);
+    for (int k=0; k < N_MODELS; k++) {
+        indv_dest->objectives[k] = indv_source->objectives[k];
+        indv_dest->penalty_objectives[k] = indv_source->penalty_objectives[k];
+    }
+    indv_dest->rank = indv_source->rank;
+    indv_dest->crowding_distance = indv_source->crowding_distance;
+    indv_dest->operators = indv_source->operators;
+}
+
+/* Sites [site1, site2) come from the other parent */
+static void
+KERNEL(crossover_segment)(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, int site1, int site2)
+{
+    int j, k, swap;
+
+    for (j=0; j < mcp->n_vars; j++) {
+        swap = (j >= site1) && (j < site2);
+        child1->deletions[j] = swap ? parent2->deletions[j] : parent1->deletions[j];
+        child2->deletions[j] = swap ? parent1->deletions[j] : parent2->deletions[j];
+    }
+    if (KERNEL_MODULES) {
+        for (k=0; k < N_MODELS; k++) {
+            for (j=0; j < mcp->n_vars; j++) {
+                swap = (j >= site1) && (j < site2);
+                child1->modules[k*mcp->n_vars + j] = swap ? parent2->modules[k*mcp->n_vars + j] : parent1->modules[k*mcp->n_vars + j];
+                child2->modules[k*mcp->n_vars + j] = swap ? parent1->modules[k*mcp->n_vars + j] : parent2->modules[k*mcp->n_vars + j];
+            }
+        }
+    }
+}
+
+static void
+KERNEL(crossover_uniform)(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng)
+{
+    int j, k;
+    Individual *temp;
+
+    for (j=0; j < mcp->n_vars; j++) {
+        if (pcg32_boundedrand_r(rng, 2)) { /* swap parents for this site */
+            temp = parent1;
+            parent1 = parent2;
+            parent2 = temp;
+        }
+        child1->deletions[j] = parent1->deletions[j];
+        child2->deletions[j] = parent2->deletions[j];
+        if (KERNEL_MODULES) {
+            for (k=0; k < N_MODELS; k++) {
+                child1->modules[k*mcp->n_vars + j] = parent1->modules[k*mcp->n_vars + j];
+                child2->modules[k*mcp->n_vars + j] = parent2->modules[k*mcp->n_vars + j];
+            }
+        }
+    }
+}
+
+/* Without epsilon dominance */
+static int
+KERNEL(find_domination)(MCproblem *mcp, Individual *indv_a, Individual *indv_b)
+{
+    int a_dominates_b = 1;
+    int b_dominates_a = 1;
+
+    for (int i=0; i < N_MODELS; i++){
+        a_dominates_b &= !(indv_b->penalty_objectives[i] > indv_a->penalty_objectives[i]);
+        b_dominates_a &= !(indv_a->penalty_objectives[i] > indv_b->penalty_objectives[i]);
+    }
+    if(a_dominates_b && b_dominates_a) return NONDOMINATED; /* both objective vectors are equal */
+    if(a_dominates_b) return A_DOMINATES_B;
+    if(b_dominates_a) return B_DOMINATES_A;
+    return NONDOMINATED;
+}
+
+/* Sets change_bound[j] to 1 for the reactions whose bounds are blocked in model k, returns their number */
+static int
+KERNEL(set_change_bound)(MCproblem *mcp, Individual *indv, int k, int *change_bound)
+{
+    LPproblem *lp = &(mcp->lps[k]);
+    int j, n_changed = 0;
+
+    for (j=0; j < mcp->n_vars; j++) {
+        change_bound[j] = (lp->cand_col_idx[j] != NOT_CANDIDATE) && (indv->deletions[j] == DELETED_RXN);
+        if (KERNEL_MODULES)
+            change_bound[j] &= (indv->modules[k*mcp->n_vars + j] != MODULE_RXN); /* Reaction inserted back as module */
+        n_changed += change_bound[j];
+    }
+    return n_changed;
+}
+
+#undef N_MODELS
@@ -0,0 +1,105 @@
+/* Specialized variants of the genetic operator, evaluation and dominance kernels, for modules on and off and for 2, 4, 8, 16 or any number of models. kernels_init() selects the variant of the problem once and the functions in functions.c call it through the kernels table.
+ * Notes:
+ *      - The variants are generated from kernel_template.h.
+ */
+
+#include "modcell.h"
+
+#define CONCAT_(a, b) a##b
+#define CONCAT(a, b) CONCAT_(a, b)
+#define KERNEL(name) CONCAT(name, KERNEL_SUFFIX)
+
+#define INSTANTIATE(suffix, modules, n_models) \
+    {{copy_individual##suffix, crossover_segment##suffix, crossover_uniform##suffix, find_domination##suffix, set_change_bound##suffix}, modules, n_models}
+
+void kernels_init(MCproblem *mcp);
+
+/* Globals */
+Kernels kernels;
+
+/* Modules off */
+#define KERNEL_MODULES 0
+#define KERNEL_SUFFIX _m0_n2
+#define KERNEL_N_MODELS 2
+#include "kernel_template.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_N_MODELS
+#define KERNEL_SUFFIX _m0_n4
+#define KERNEL_N_MODELS 4
+#include "kernel_template.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_N_MODELS
+#define KERNEL_SUFFIX _m0_n8
+#define KERNEL_N_MODELS 8
+#include "kernel_template.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_N_MODELS
+#define KERNEL_SUFFIX _m0_n16
+#define KERNEL_N_MODELS 16
+#include "kernel_template.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_N_MODELS
+#define KERNEL_SUFFIX _m0_generic
+#define KERNEL_N_MODELS 0
+#include "kernel_template.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_N_MODELS
+#undef KERNEL_MODULES
+
+/* Modules on */
+#define KERNEL_MODULES 1
+#define KERNEL_SUFFIX _m1_n2
+#define KERNEL_N_MODELS 2
+#include "kernel_template.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_N_MODELS
+#define KERNEL_SUFFIX _m1_n4
+#define KERNEL_N_MODELS 4
+#include "kernel_template.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_N_MODELS
+#define KERNEL_SUFFIX _m1_n8
+#define KERNEL_N_MODELS 8
+#include "kernel_template.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_N_MODELS
+#define KERNEL_SUFFIX _m1_n16
+#define KERNEL_N_MODELS 16
+#include "kernel_template.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_N_MODELS
+#define KERNEL_SUFFIX _m1_generic
+#define KERNEL_N_MODELS 0
+#include "kernel_template.h"
+#undef KERNEL_SUFFIX
+#undef KERNEL_N_MODELS
+#undef KERNEL_MODULES
+
+static const struct {
+    Kernels k;
+    int use_modules;
+    unsigned int n_models; /* 0 for any */
+} variants[] = {
+    INSTANTIATE(_m0_n2, 0, 2),
+    INSTANTIATE(_m0_n4, 0, 4),
+    INSTANTIATE(_m0_n8, 0, 8),
+    INSTANTIATE(_m0_n16, 0, 16),
+    INSTANTIATE(_m0_generic, 0, 0),
+    INSTANTIATE(_m1_n2, 1, 2),
+    INSTANTIATE(_m1_n4, 1, 4),
+    INSTANTIATE(_m1_n8, 1, 8),
+    INSTANTIATE(_m1_n16, 1, 16),
+    INSTANTIATE(_m1_generic, 1, 0),
+};
+
+/* Selects the first variant matching the problem, the generic ones match any number of models */
+void
+kernels_init(MCproblem *mcp)
+{
+    for (int i=0; i < sizeof(variants)/sizeof(variants[0]); i++) {
+        if ((variants[i].use_modules == mcp->use_modules) && ((variants[i].n_models == mcp->n_models) || (variants[i].n_models == 0))) {
+            kernels = variants[i].k;
+            return;
+        }
+    }
+}
@@ -0,0 +1,280 @@
+/* Memetic local search. A few non-dominated individuals of the population are improved by a hill climber over their neighbourhood: dropping a deletion, adding one (while within alpha), swapping a deleted reaction for a kept one, and toggling a module reaction.
+ * Notes:
+ *      - Each neighbour differs from its parent in the bounds of at most two reactions. Neighbours are sampled in batches of LOCAL_SEARCH_BATCH and evaluated model by model: the parent bounds are applied and solved once, and each neighbour only flips its own bounds and is warm-started from the parent basis, so its solve usually takes a few simplex iterations.
+ *      - Swaps make the neighbourhood O(alpha*n_vars), so it is sampled rather than enumerated.
+ *      - The neighbour that dominates its parent with the largest objective gain replaces it, keeping the rank and crowding distance of the parent.
+ */
+
+#include <stdlib.h>
+#include "modcell.h"
+
+#define LOCAL_SEARCH_INDIVIDUALS 4 /* Non-dominated individuals improved per call */
+#define LOCAL_SEARCH_BATCH 32 /* Neighbours evaluated per step */
+#define LOCAL_SEARCH_STEPS 3 /* Maximum accepted moves per individual and call */
+#define MAX_MOVE_ATTEMPTS 10
+
+extern glp_smcp param;
+
+typedef struct {
+    int var[2]; /* Reactions whose deletion or module state changes, -1 if unused */
+    int model;  /* Only model affected (module toggles), -1 if all models are affected */
+} Move;
+
+void local_search_init(MCproblem *mcp);
+void local_search_free(MCproblem *mcp);
+unsigned int local_search(MCproblem *mcp, Population *pop);
+static int improve_individual(MCproblem *mcp, Individual *indv);
+static int set_neighbour(MCproblem *mcp, Individual *parent, Individual *neighbour, Move *move);
+static void evaluate_neighbours(MCproblem *mcp, Individual *parent, int n_neighbours);
+static int is_blocked(MCproblem *mcp, Individual *indv, int k, int j);
+static void set_blocked(LPproblem *lp, int j, int blocked);
+
+/* Globals */
+static Population neighbours; /* [LOCAL_SEARCH_BATCH] */
+static Move moves[LOCAL_SEARCH_BATCH];
+static int *deleted_idx, *kept_idx; /* [n_vars] Reactions deleted and kept by the current parent */
+static int n_deleted, n_kept;
+static int *parent_blocked; /* [n_vars] */
+static unsigned char *parent_basis; /* [basis_size] */
+static int *front_idx; /* [population_size] */
+
+void
+local_search_init(MCproblem *mcp)
+{
+    allocate_population(mcp, &neighbours, LOCAL_SEARCH_BATCH);
+    set_blank_population(mcp, &neighbours);
+    SAFE_ALLOC(deleted_idx = malloc(mcp->n_vars * sizeof *deleted_idx))
+    SAFE_ALLOC(kept_idx = malloc(mcp->n_vars * sizeof *kept_idx))
+    SAFE_ALLOC(parent_blocked = malloc(mcp->n_vars * sizeof *parent_blocked))
+    SAFE_ALLOC(parent_basis = malloc(mcp->basis_size * sizeof *parent_basis))
+    SAFE_ALLOC(front_idx = malloc(mcp->population_size * sizeof *front_idx))
+}
+
+void
+local_search_free(MCproblem *mcp)
+{
+    free_population(mcp, &neighbours);
+    free(deleted_idx);
+    free(kept_idx);
+    free(parent_blocked);
+    free(parent_basis);
+    free(front_idx);
+}
+
+/* Applies local search to up to LOCAL_SEARCH_INDIVIDUALS random individuals of the first front. Returns the number of accepted moves. */
+unsigned int
+local_search(MCproblem *mcp, Population *pop)
+{
+    int i, n_front = 0, target, temp, step;
+    unsigned int n_accepted = 0;
+
+    for (i=0; i < pop->size; i++)
+        if (pop->indv[i].rank == 1)
+            front_idx[n_front++] = i;
+
+    for (i=0; (i < LOCAL_SEARCH_INDIVIDUALS) && (i < n_front); i++) {
+        target = i + pcg32_boundedrand(n_front - i); /* Partial Fisher-Yates shuffle */
+        temp = front_idx[i];
+        front_idx[i] = front_idx[target];
+        front_idx[target] = temp;
+
+        for (step=0; step < LOCAL_SEARCH_STEPS; step++) {
+            if (!improve_individual(mcp, &(pop->indv[front_idx[i]])))
+                break;
+            n_accepted++;
+        }
+    }
+    return n_accepted;
+}
+
+/* Evaluates a batch of neighbours of indv and replaces it by the best one that dominates it. Returns 1 if indv was replaced. */
+static int
+improve_individual(MCproblem *mcp, Individual *indv)
+{
+    int j, k, b, n_neighbours = 0, best = -1;
+    double gain, best_gain = 0;
+    Individual *nb;
+
+    n_deleted = n_kept = 0;
+    for (j=0; j < mcp->n_vars; j++) {
+        if (indv->deletions[j] == DELETED_RXN)
+            deleted_idx[n_deleted++] = j;
+        else
+            kept_idx[n_kept++] = j;
+    }
+
+    for (b=0; b < LOCAL_SEARCH_BATCH; b++)
+        if (set_neighbour(mcp, indv, &(neighbours.indv[n_neighbours]), &(moves[n_neighbours])))
+            n_neighbours++;
+    if (n_neighbours == 0)
+        return 0;
+
+    evaluate_neighbours(mcp, indv, n_neighbours);
+
+    for (b=0; b < n_neighbours; b++) {
+        nb = &(neighbours.indv[b]);
+        if (mcp->archive_path[0] != '\0')
+            archive_offer(mcp, nb);
+        if (find_domination(mcp, nb, indv) != A_DOMINATES_B)
+            continue;
+        gain = 0;
+        for (k=0; k < mcp->n_models; k++)
+            gain += nb->penalty_objectives[k] - indv->penalty_objectives[k];
+        if ((best == -1) || (gain > best_gain)) {
+            best = b;
+            best_gain = gain;
+        }
+    }
+    if (best == -1)
+        return 0;
+
+    nb = &(neighbours.indv[best]);
+    nb->rank = indv->rank;
+    nb->crowding_distance = indv->crowding_distance;
+    copy_individual(mcp, nb, indv);
+    return 1;
+}
+
+/* Samples a random move applicable to parent and stores the result in neighbour. Returns 0 if no move was found. */
+static int
+set_neighbour(MCproblem *mcp, Individual *parent, Individual *neighbour, Move *move)
+{
+    int attempt, k, j, j2, n_modules, module_idx[MAX_MODULES];
+
+    for (attempt=0; attempt < MAX_MOVE_ATTEMPTS; attempt++) {
+        move->var[0] = move->var[1] = -1;
+        move->model = -1;
+        switch (pcg32_boundedrand(mcp->use_modules ? 4 : 3)) {
+            case 0: /* Drop */
+                if (n_deleted == 0)
+                    continue;
+                move->var[0] = deleted_idx[pcg32_boundedrand(n_deleted)];
+                break;
+            case 1: /* Add */
+                if ((n_kept == 0) || (n_deleted >= mcp->alpha))
+                    continue;
+                move->var[0] = kept_idx[pcg32_boundedrand(n_kept)];
+                break;
+            case 2: /* Swap */
+                if ((n_kept == 0) || (n_deleted == 0))
+                    continue;
+                move->var[0] = deleted_idx[pcg32_boundedrand(n_deleted)];
+                move->var[1] = kept_idx[pcg32_boundedrand(n_kept)];
+                break;
+            case 3: /* Module toggle */
+                if (n_deleted == 0)
+                    continue;
+                move->model = pcg32_boundedrand(mcp->n_models);
+                move->var[0] = deleted_idx[pcg32_boundedrand(n_deleted)];
+                break;
+        }
+        break;
+    }
+    if (attempt == MAX_MOVE_ATTEMPTS)
+        return 0;
+
+    copy_individual(mcp, parent, neighbour);
+    if (move->model == -1) {
+        for (int v=0; v < 2; v++) {
+            j = move->var[v];
+            if (j == -1)
+                continue;
+            neighbour->deletions[j] = !neighbour->deletions[j];
+            if (mcp->use_modules && (neighbour->deletions[j] != DELETED_RXN)) /* Modules must be deletions */
+                for (k=0; k < mcp->n_models; k++)
+                    neighbour->modules[k*mcp->n_vars + j] = !MODULE_RXN;
+        }
+    }
+    else {
+        k = move->model;
+        j = move->var[0];
+        if (neighbour->modules[k*mcp->n_vars + j] == MODULE_RXN) {
+            neighbour->modules[k*mcp->n_vars + j] = !MODULE_RXN;
+        }
+        else {
+            n_modules = 0;
+            for (j2=0; j2 < mcp->n_vars; j2++)
+                if (neighbour->modules[k*mcp->n_vars + j2] == MODULE_RXN)
+                    module_idx[n_modules++] = j2;
+            if (n_modules >= mcp->beta) { /* Swap modules to stay within beta */
+                j2 = module_idx[pcg32_boundedrand(n_modules)];
+                neighbour->modules[k*mcp->n_vars + j2] = !MODULE_RXN;
+                move->var[1] = j2;
+            }
+            neighbour->modules[k*mcp->n_vars + j] = MODULE_RXN;
+        }
+    }
+    return 1;
+}
+
+/* Sets the objectives and penalty objectives of the first n_neighbours neighbours of parent */
+static void
+evaluate_neighbours(MCproblem *mcp, Individual *parent, int n_neighbours)
+{
+    LPproblem *lp;
+    Individual *nb;
+    int j, k, b, v, changed[2];
+
+    for (k=0; k < mcp->n_models; k++) {
+        lp = &(mcp->lps[k]);
+
+        /* Solve the parent once, its basis is the starting point of all neighbours */
+        for (j=0; j < mcp->n_vars; j++) {
+            parent_blocked[j] = is_blocked(mcp, parent, k, j);
+            if (parent_blocked[j])
+                set_blocked(lp, j, 1);
+        }
+        glp_simplex(lp->P, &param);
+        save_basis(mcp, k, parent_basis);
+
+        for (b=0; b < n_neighbours; b++) {
+            nb = &(neighbours.indv[b]);
+            if ((moves[b].model != -1) && (moves[b].model != k)) {
+                nb->objectives[k] = parent->objectives[k];
+                continue;
+            }
+            load_basis(mcp, k, parent_basis);
+            for (v=0; v < 2; v++) {
+                j = moves[b].var[v];
+                changed[v] = (j != -1) && (is_blocked(mcp, nb, k, j) != parent_blocked[j]);
+                if (changed[v])
+                    set_blocked(lp, j, !parent_blocked[j]);
+            }
+            if ((glp_simplex(lp->P, &param) == 0) && (glp_get_status(lp->P) == GLP_OPT))
+                nb->objectives[k] = glp_get_col_prim(lp->P, lp->prod_col_idx)/lp->max_prod_growth;
+            else
+                nb->objectives[k] = 0;
+            for (v=0; v < 2; v++)
+                if (changed[v])
+                    set_blocked(lp, moves[b].var[v], parent_blocked[moves[b].var[v]]);
+        }
+
+        /* Reset bounds */
+        for (j=0; j < mcp->n_vars; j++)
+            if (parent_blocked[j])
+                set_blocked(lp, j, 0);
+    }
+
+    for (b=0; b < n_neighbours; b++)
+        set_penalty_objectives(mcp, &(neighbours.indv[b]));
+}
+
+/* Same criteria as calculate_objective() */
+static int
+is_blocked(MCproblem *mcp, Individual *indv, int k, int j)
+{
+    if ((mcp->lps[k].cand_col_idx[j] == NOT_CANDIDATE) || (indv->deletions[j] != DELETED_RXN))
+        return 0;
+    return !(mcp->use_modules && (indv->modules[k*mcp->n_vars + j] == MODULE_RXN));
+}
+
+static void
+set_blocked(LPproblem *lp, int j, int blocked)
+{
+    if (lp->cand_col_idx[j] == NOT_CANDIDATE)
+        return;
+    if (blocked)
+        glp_set_col_bnds(lp->P, lp->cand_col_idx[j], GLP_FX, 0, 0);
+    else
+        glp_set_col_bnds(lp->P, lp->cand_col_idx[j], lp->cand_col_type[j], lp->cand_og_lb[j], lp->cand_og_ub[j]);
+}
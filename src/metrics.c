@@ -0,0 +1,332 @@
+/* Front quality metrics computed during the run and written to a per-PE csv file.
+ * Notes:
+ *      - Metrics are computed on the non-dominated individuals of the population using penalty_objectives (i.e., what the MOEA optimizes).
+ *      - The hypervolume reference point is the origin, since design objectives are non-negative and maximized. It is exact up to METRICS_HV_EXACT_MAX_OBJ objectives and a Monte-Carlo estimate otherwise.
+ *      - The true Pareto front is not known, so generational distance is measured against the front of the previous metrics evaluation, i.e., it indicates how much the front is still moving.
+ *      - New front points are counted against the non-dominated union of all previously recorded fronts (bounded to BEST_FRONT_FACTOR*population_size vectors), so points that are lost and later rediscovered are not counted as new.
+ *      - A private RNG stream is used for Monte-Carlo sampling so that recording metrics does not change the search.
+ *      - Metrics are also used by the convergence criteria (convergence.c), in which case they are computed even if no metrics file is written.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "modcell.h"
+
+#define METRICS_HV_EXACT_MAX_OBJ 4 	/* Above this number of objectives the hypervolume is estimated */
+#define METRICS_HV_SAMPLES 100000 	/* Monte-Carlo samples for hypervolume estimation */
+#define BEST_FRONT_FACTOR 4
+
+void metrics_init(MCproblem *mcp);
+void metrics_free(void);
+void metrics_record(MCproblem *mcp, Population *pop, unsigned int generation, double run_time, FrontMetrics *fm);
+size_t nondominated_objectives(MCproblem *mcp, Population *pop, double *front);
+double hypervolume(int n_obj, double *front, size_t n_points);
+static double hv_exact(int n_obj, double *front, size_t n_points, double *buff);
+static double hv_estimate(int n_obj, double *front, size_t n_points);
+static double spread(int n_obj, double *front, size_t n_points);
+static double generational_distance(int n_obj, double *front, size_t n_points, double *ref_front, size_t n_ref);
+static size_t update_best_front(int n_obj, double *front, size_t n_points);
+
+extern int mpi_pe;
+
+/* Globals */
+static FILE *metrics_file;
+static double *front; 		/* [population_size*n_models] */
+static double *prev_front; 	/* [population_size*n_models] */
+static size_t prev_size;
+static double *best_front; 	/* [BEST_FRONT_FACTOR*population_size*n_models] */
+static size_t best_size, best_capacity;
+static pcg32_random_t metrics_rng;
+
+void
+metrics_init(MCproblem *mcp)
+{
+    metrics_file = NULL;
+    if (mcp->metrics_path[0] != '\0') {
+        if (!(metrics_file = fopen (mcp->metrics_path, "w"))) {
+            fprintf (stderr, "error: file open failed '%s'.", mcp->metrics_path);
+            exit(-1);
+        }
+        fprintf(metrics_file, "generation,time,front_size,new_front_points,hypervolume,spread,generational_distance\n");
+    }
+
+    SAFE_ALLOC(front = malloc(mcp->population_size * mcp->n_models * sizeof *front))
+    SAFE_ALLOC(prev_front = malloc(mcp->population_size * mcp->n_models * sizeof *prev_front))
+    prev_size = 0;
+    best_capacity = BEST_FRONT_FACTOR * mcp->population_size;
+    SAFE_ALLOC(best_front = malloc(best_capacity * mcp->n_models * sizeof *best_front))
+    best_size = 0;
+    pcg32_srandom_r(&metrics_rng, mcp->seed + mpi_pe, 0x4d4554524943ULL);
+}
+
+void
+metrics_free(void)
+{
+    if (metrics_file)
+        fclose(metrics_file);
+    free(front);
+    free(prev_front);
+    free(best_front);
+}
+
+/* Computes front metrics of pop, appends them to the metrics file (if any) and returns them in fm (if not NULL) */
+void
+metrics_record(MCproblem *mcp, Population *pop, unsigned int generation, double run_time, FrontMetrics *fm)
+{
+    FrontMetrics m;
+    size_t n = nondominated_objectives(mcp, pop, front);
+
+    m.front_size = n;
+    m.hypervolume = hypervolume(mcp->n_models, front, n);
+    m.spread = spread(mcp->n_models, front, n);
+    m.generational_distance = prev_size > 0 ? generational_distance(mcp->n_models, front, n, prev_front, prev_size) : 0;
+    m.new_points = update_best_front(mcp->n_models, front, n);
+
+    if (metrics_file) {
+        fprintf(metrics_file, "%u,%.2f,%zu,%zu,%.8f,%.6f,%.8f\n", generation, run_time, m.front_size, m.new_points, m.hypervolume, m.spread, m.generational_distance);
+        fflush(metrics_file);
+    }
+
+    memcpy(prev_front, front, n * mcp->n_models * sizeof *front);
+    prev_size = n;
+    if (fm)
+        *fm = m;
+}
+
+/* Copies the objective vectors of the non-dominated individuals of pop into front ([pop->size*n_models]), duplicated vectors are only copied once. Returns the number of vectors. */
+size_t
+nondominated_objectives(MCproblem *mcp, Population *pop, double *front)
+{
+    size_t i, j, n = 0;
+    int k, is_dominated, is_duplicate;
+
+    for (i=0; i < pop->size; i++) {
+        is_dominated = 0;
+        for (j=0; j < pop->size; j++) {
+            if (find_domination(mcp, &(pop->indv[j]), &(pop->indv[i])) == A_DOMINATES_B) {
+                is_dominated = 1;
+                break;
+            }
+        }
+        if (is_dominated)
+            continue;
+        for (j=0; j < n; j++) {
+            is_duplicate = 1;
+            for (k=0; k < mcp->n_models; k++)
+                if (front[j*mcp->n_models + k] != pop->indv[i].penalty_objectives[k])
+                    is_duplicate = 0;
+            if (is_duplicate)
+                break;
+        }
+        if (j < n)
+            continue;
+        for (k=0; k < mcp->n_models; k++)
+            front[n*mcp->n_models + k] = pop->indv[i].penalty_objectives[k];
+        n++;
+    }
+    return n;
+}
+
+/* Volume dominated by the points in front ([n_points*n_obj]) with respect to the origin. */
+double
+hypervolume(int n_obj, double *front, size_t n_points)
+{
+    double hv, *buff;
+
+    if (n_points == 0)
+        return 0;
+    if (n_obj > METRICS_HV_EXACT_MAX_OBJ)
+        return hv_estimate(n_obj, front, n_points);
+
+    SAFE_ALLOC(buff = malloc(n_obj * n_obj * n_points * sizeof *buff))
+    hv = hv_exact(n_obj, front, n_points, buff);
+    free(buff);
+    return hv;
+}
+
+static int g_hv_k;
+static int
+hvcmp(const void *a, const void *b)
+{
+    double va = ((const double *)a)[g_hv_k], vb = ((const double *)b)[g_hv_k];
+    return (va < vb) - (va > vb); /* descending */
+}
+
+/* Hypervolume by slicing objectives: the points are sorted by the last objective and each slice between consecutive values is the (n_obj-1)-dimensional hypervolume of the points above it.
+ *      - front is sorted in place.
+ *      - buff holds the projected points of all recursion levels ([n_obj*n_obj*n_points] is always enough).
+ */
+static double
+hv_exact(int n_obj, double *front, size_t n_points, double *buff)
+{
+    size_t i, j;
+    int k;
+    double hv = 0, next;
+
+    if (n_obj == 1) {
+        for (i=0; i < n_points; i++)
+            if (front[i] > hv)
+                hv = front[i];
+        return hv;
+    }
+
+    g_hv_k = n_obj - 1;
+    qsort(front, n_points, n_obj * sizeof *front, hvcmp);
+
+    if (n_obj == 2) { /* Sweep */
+        double max_first = 0;
+        for (i=0; (i < n_points) && (front[i*2 + 1] > 0); i++) {
+            next = (i+1 < n_points) ? front[(i+1)*2 + 1] : 0;
+            if (front[i*2] > max_first)
+                max_first = front[i*2];
+            hv += (front[i*2 + 1] - (next > 0 ? next : 0)) * max_first;
+        }
+        return hv;
+    }
+
+    double *proj = buff;
+    for (i=0; i < n_points; i++) {
+        next = (i+1 < n_points) ? front[(i+1)*n_obj + n_obj-1] : 0;
+        if (next < 0)
+            next = 0;
+        /* Project points 0..i to the first n_obj-1 objectives */
+        for (j=0; j <= i; j++)
+            for (k=0; k < n_obj-1; k++)
+                proj[j*(n_obj-1) + k] = front[j*n_obj + k];
+        if (front[i*n_obj + n_obj-1] > next)
+            hv += (front[i*n_obj + n_obj-1] - next) * hv_exact(n_obj-1, proj, i+1, proj + (i+1)*(n_obj-1));
+    }
+    return hv;
+}
+
+/* Monte-Carlo estimate of the hypervolume, samples are drawn from the box between the origin and the maximum of each objective */
+static double
+hv_estimate(int n_obj, double *front, size_t n_points)
+{
+    size_t i, s, n_dominated = 0;
+    int k;
+    double upper[n_obj], sample[n_obj], volume = 1;
+
+    for (k=0; k < n_obj; k++) {
+        upper[k] = 0;
+        for (i=0; i < n_points; i++)
+            if (front[i*n_obj + k] > upper[k])
+                upper[k] = front[i*n_obj + k];
+        volume *= upper[k];
+    }
+    if (volume == 0)
+        return 0;
+
+    for (s=0; s < METRICS_HV_SAMPLES; s++) {
+        for (k=0; k < n_obj; k++)
+            sample[k] = upper[k] * ldexp(pcg32_random_r(&metrics_rng), -32);
+        for (i=0; i < n_points; i++) {
+            for (k=0; k < n_obj; k++)
+                if (sample[k] > front[i*n_obj + k])
+                    break;
+            if (k == n_obj) {
+                n_dominated++;
+                break;
+            }
+        }
+    }
+    return volume * n_dominated / METRICS_HV_SAMPLES;
+}
+
+/* Spread as the relative mean absolute deviation of nearest neighbour (Euclidean) distances, 0 indicates evenly spaced points */
+static double
+spread(int n_obj, double *front, size_t n_points)
+{
+    size_t i, j;
+    int k;
+    double d, mean = 0, dev = 0, *nn;
+
+    if (n_points < 2)
+        return 0;
+    SAFE_ALLOC(nn = malloc(n_points * sizeof *nn))
+    for (i=0; i < n_points; i++) {
+        nn[i] = INF;
+        for (j=0; j < n_points; j++) {
+            if (i == j)
+                continue;
+            d = 0;
+            for (k=0; k < n_obj; k++)
+                d += (front[i*n_obj + k] - front[j*n_obj + k]) * (front[i*n_obj + k] - front[j*n_obj + k]);
+            if (d < nn[i])
+                nn[i] = d;
+        }
+        nn[i] = sqrt(nn[i]);
+        mean += nn[i];
+    }
+    mean /= n_points;
+    for (i=0; i < n_points; i++)
+        dev += fabs(nn[i] - mean);
+    free(nn);
+    return mean > 0 ? dev / (n_points * mean) : 0;
+}
+
+/* Mean Euclidean distance from each point of front to the closest point of ref_front */
+static double
+generational_distance(int n_obj, double *front, size_t n_points, double *ref_front, size_t n_ref)
+{
+    size_t i, j;
+    int k;
+    double d, dmin, gd = 0;
+
+    if (n_points == 0)
+        return 0;
+    for (i=0; i < n_points; i++) {
+        dmin = INF;
+        for (j=0; j < n_ref; j++) {
+            d = 0;
+            for (k=0; k < n_obj; k++)
+                d += (front[i*n_obj + k] - ref_front[j*n_obj + k]) * (front[i*n_obj + k] - ref_front[j*n_obj + k]);
+            if (d < dmin)
+                dmin = d;
+        }
+        gd += sqrt(dmin);
+    }
+    return gd / n_points;
+}
+
+/* Adds the points of front that are not weakly dominated by best_front to it (removing the ones they dominate), returns the number of such points */
+static size_t
+update_best_front(int n_obj, double *front, size_t n_points)
+{
+    size_t i, j, n_new = 0;
+    int k, dominates;
+
+    for (i=0; i < n_points; i++) {
+        for (j=0; j < best_size; j++) {
+            for (k=0; k < n_obj; k++)
+                if (best_front[j*n_obj + k] < front[i*n_obj + k])
+                    break;
+            if (k == n_obj)
+                break;
+        }
+        if (j < best_size)
+            continue;
+        n_new++;
+
+        /* Remove dominated points by moving the last one into their place */
+        for (j=0; j < best_size; ) {
+            dominates = 1;
+            for (k=0; k < n_obj; k++)
+                if (front[i*n_obj + k] < best_front[j*n_obj + k])
+                    dominates = 0;
+            if (dominates) {
+                best_size--;
+                for (k=0; k < n_obj; k++)
+                    best_front[j*n_obj + k] = best_front[best_size*n_obj + k];
+            } else
+                j++;
+        }
+        if (best_size < best_capacity) {
+            for (k=0; k < n_obj; k++)
+                best_front[best_size*n_obj + k] = front[i*n_obj + k];
+            best_size++;
+        }
+    }
+    return n_new;
+}
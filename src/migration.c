@@ -0,0 +1,351 @@
+/* Migration of individuals between islands (PEs).
+ * Notes:
+ *      - All migrants of one message are packed (MPI_Pack) together after a header with their number, the sender, its stall (see topology.c) and whether it uses modules: for each migrant the number of deletions, the indices of the deleted reactions, the objectives, the penalty objectives and the crowding distance, and, if modules are used, whether each deleted reaction is a module in each model (modules can only be deletions, see enforce_module_constraints()).
+ *      - Islands can differ in alpha and beta (see --island_config), so receivers set the penalty objectives of migrants with their own alpha, and drop the module reactions of migrants they cannot use (if beta is 0, or beyond beta in a model, the first beta modules in reaction order are kept), in which case the migrant is evaluated again.
+ *      - The islands a migration is sent to are given by topology.c. Each message carries migration_size/fan_out migrants, where fan_out is the number of islands reached by one migration.
+ *      - Two transports. Point-to-point: each migration has one send request per target, and a new migration is only initiated once they complete. Receives are not pre-posted, every call to migration_status() receives all the messages that have arrived (MPI_Iprobe), so islands that many others send to (e.g., stalled islands with the adaptive topology) do not fall behind. The receive buffers are sized for migrants with n_vars deletions, the actual size is given by the message. One-sided (RMA): each island exposes a mailbox window of MAILBOX_SLOTS*fan_out message slots, a sender takes a ticket from the target's counter and puts its message in slot ticket % n_slots, all within one passive target exclusive lock, so slots are always read whole. The receiver absorbs up to fan_out messages per call to migration_status(), oldest first, without waiting for any other island. If a mailbox is not emptied fast enough the oldest messages are overwritten.
+ *      - With both transports at most fan_out messages are kept per call to migration_status(), the newest ones, older messages are dropped. Messages are only received after the first send of an island, which chooses the individuals they replace.
+ *      - Migration policies other than random depend on how parent_population is sorted. The random policy sends and replaces the same individuals, drawn with replacement. With the one-sided transport the individuals replaced are those chosen by the last send, so messages arriving before the first send of an island wait in its mailbox.
+ *      - The point-to-point form of async migration does not differentiate between sending and receiving data. An even more decoupled approach could separate these two aspects. Although this might not necessary be good for the heuristics. However, for certain topologies if an island is particularly slow it can lock several other migrations.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "modcell.h"
+
+#define MIGRATION_TAG 10
+#define MAILBOX_SLOTS 4 /* Per island reached by one migration */
+#define SLOT_HEADER 8 /* Bytes before the packed message in a slot and in send_buffer, the first int is the ticket (0 if the slot is empty) */
+
+extern int mpi_pe, mpi_comm_size;
+
+void migration_init(MCproblem *mcp);
+void migration_free(MCproblem *mcp);
+void migration_initiate(MCproblem *mcp, Population *parent_population, int *receive_idx);
+int migration_sending(MCproblem *mcp);
+int migration_status(MCproblem *mcp);
+int migration_step(MCproblem *mcp, Population *parent_population, int *receive_idx, unsigned int n_generations, double begin);
+int migration_receive(MCproblem *mcp, Population *receive_population);
+void migration_complete(MCproblem *mcp, Population *parent_population, Population *receive_population, int *receive_idx);
+void migration_cancel(MCproblem *mcp);
+static void pack_individual(MCproblem *mcp, Individual *indv, char *buffer, int *position);
+static void unpack_individual(MCproblem *mcp, Individual *indv, char *buffer, int *position, int has_modules);
+static void mailbox_put(int target_pe, int size);
+static int mailbox_take(void);
+
+/* Globals */
+static char *send_buffer; 	/* [SLOT_HEADER + buffer_size] */
+static char *recv_buffers; 	/* [fan_out*buffer_size] */
+static int buffer_size;
+static int fan_out, n_per_message, n_received;
+static int *targets; 		/* [fan_out] */
+static int *send_idx; 		/* [migration_size] */
+static int *deleted_rxns; 	/* [n_vars] */
+static bool *module_flags; 	/* [n_vars] */
+static MPI_Request *requests; 	/* [fan_out] Sends */
+static int n_requests;
+static MPI_Win mailbox_win; 	/* One-sided transport: ticket counter followed by n_slots slots */
+static char *mailbox; 		/* Local memory of mailbox_win */
+static MPI_Aint slot_size;
+static int n_slots;
+static int n_sent; 		/* Number of migrations initiated */
+
+void
+migration_init(MCproblem *mcp)
+{
+    int size, any_modules;
+
+    fan_out = topology_fan_out(mcp);
+    n_per_message = mcp->migration_size / fan_out;
+
+    /* Upper bound of the packed size of one message */
+    MPI_Allreduce(&(mcp->use_modules), &any_modules, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Pack_size(4, MPI_INT, MPI_COMM_WORLD, &buffer_size);
+    MPI_Pack_size(1 + mcp->n_vars, MPI_INT, MPI_COMM_WORLD, &size);
+    buffer_size += n_per_message * size;
+    MPI_Pack_size(2*mcp->n_models + 1, MPI_DOUBLE, MPI_COMM_WORLD, &size);
+    buffer_size += n_per_message * size;
+    if (any_modules) {
+        MPI_Pack_size(mcp->n_vars, MPI_C_BOOL, MPI_COMM_WORLD, &size);
+        buffer_size += n_per_message * mcp->n_models * size;
+    }
+
+    SAFE_ALLOC(send_buffer = malloc(SLOT_HEADER + buffer_size))
+    SAFE_ALLOC(recv_buffers = malloc(fan_out * buffer_size))
+    SAFE_ALLOC(targets = malloc(fan_out * sizeof *targets))
+    SAFE_ALLOC(send_idx = malloc((mcp->migration_size + 1) * sizeof *send_idx))
+    SAFE_ALLOC(deleted_rxns = malloc(mcp->n_vars * sizeof *deleted_rxns))
+    SAFE_ALLOC(module_flags = malloc(mcp->n_vars * sizeof *module_flags))
+    SAFE_ALLOC(requests = malloc(fan_out * sizeof *requests))
+    n_requests = 0;
+    n_received = 0;
+    n_sent = 0;
+
+    if (mcp->migration_transport == MIGRATION_TRANSPORT_RMA) {
+        n_slots = MAILBOX_SLOTS * fan_out;
+        slot_size = SLOT_HEADER + ((buffer_size + SLOT_HEADER - 1)/SLOT_HEADER)*SLOT_HEADER;
+        MPI_Win_allocate(SLOT_HEADER + n_slots*slot_size, 1, MPI_INFO_NULL, MPI_COMM_WORLD, &mailbox, &mailbox_win);
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, mpi_pe, 0, mailbox_win);
+        for (MPI_Aint i=0; i < SLOT_HEADER + n_slots*slot_size; i++)
+            mailbox[i] = 0;
+        MPI_Win_unlock(mpi_pe, mailbox_win);
+        MPI_Barrier(MPI_COMM_WORLD); /* All mailboxes are empty before the first put */
+    }
+}
+
+void
+migration_free(MCproblem *mcp)
+{
+    if (mcp->migration_transport == MIGRATION_TRANSPORT_RMA)
+        MPI_Win_free(&mailbox_win);
+    free(send_buffer);
+    free(recv_buffers);
+    free(targets);
+    free(send_idx);
+    free(deleted_rxns);
+    free(module_flags);
+    free(requests);
+}
+
+/* Sends individuals to other islands, with the point-to-point transport only once migration_sending() returns 0 */
+void
+migration_initiate(MCproblem *mcp, Population *parent_population, int *receive_idx)
+{
+    int i, n_targets, stall, position = 0;
+
+    n_targets = topology_targets(mcp, parent_population, targets);
+
+    /* Determine individuals to send and receive */
+    if (mcp->migration_policy == MIGRATION_POLICY_REPLACE_SENT) {
+        for (i=0; i < mcp->migration_size; i++) {
+            send_idx[i] = i;
+            receive_idx[i] = i;
+        }
+    }
+    else if (mcp->migration_policy == MIGRATION_POLICY_REPLACE_BOTTOM) {
+        for (i=0; i < mcp->migration_size; i++) {
+            send_idx[i] = i;
+            receive_idx[i] = mcp->population_size - 1 - i;
+        }
+    }
+    else if (mcp->migration_policy == MIGRATION_POLICY_RANDOM) {
+        for (i=0; i < mcp->migration_size; i++) {
+            send_idx[i] = (int)pcg32_boundedrand(mcp->population_size);
+            receive_idx[i] = send_idx[i];
+        }
+    } else { fprintf (stderr, "error: Invalid migration policy option"); exit(-1); }
+
+    /* Message exchange, the same message goes to all targets */
+    stall = topology_stall();
+    MPI_Pack(&n_per_message, 1, MPI_INT, send_buffer + SLOT_HEADER, buffer_size, &position, MPI_COMM_WORLD);
+    MPI_Pack(&mpi_pe, 1, MPI_INT, send_buffer + SLOT_HEADER, buffer_size, &position, MPI_COMM_WORLD);
+    MPI_Pack(&stall, 1, MPI_INT, send_buffer + SLOT_HEADER, buffer_size, &position, MPI_COMM_WORLD);
+    MPI_Pack(&(mcp->use_modules), 1, MPI_INT, send_buffer + SLOT_HEADER, buffer_size, &position, MPI_COMM_WORLD);
+    for (i=0; i < n_per_message; i++)
+        pack_individual(mcp, &(parent_population->indv[send_idx[i]]), send_buffer + SLOT_HEADER, &position);
+    if (mcp->migration_transport == MIGRATION_TRANSPORT_RMA) {
+        for (i=0; i < n_targets; i++)
+            mailbox_put(targets[i], position);
+    }
+    else {
+        n_requests = 0;
+        for (i=0; i < n_targets; i++)
+            MPI_Isend(send_buffer + SLOT_HEADER, position, MPI_PACKED, targets[i], MIGRATION_TAG, MPI_COMM_WORLD, &requests[n_requests++]);
+    }
+    n_sent++;
+}
+
+/* Returns 1 while the sends of the last migration are pending (point-to-point), send_buffer cannot be reused until then */
+int
+migration_sending(MCproblem *mcp)
+{
+    int flag = 1;
+
+    if (n_requests > 0) {
+        MPI_Testall(n_requests, requests, &flag, MPI_STATUSES_IGNORE);
+        if (flag)
+            n_requests = 0;
+    }
+    return !flag;
+}
+
+/* Puts the packed message of send_buffer in a slot of the mailbox of target_pe */
+static void
+mailbox_put(int target_pe, int size)
+{
+    int one = 1, ticket;
+
+    MPI_Win_lock(MPI_LOCK_EXCLUSIVE, target_pe, 0, mailbox_win);
+    MPI_Fetch_and_op(&one, &ticket, MPI_INT, target_pe, 0, MPI_SUM, mailbox_win);
+    MPI_Win_flush(target_pe, mailbox_win);
+    ticket++; /* Tickets start at 1 */
+    *(int *)send_buffer = ticket;
+    MPI_Put(send_buffer, SLOT_HEADER + size, MPI_BYTE, target_pe, SLOT_HEADER + ((ticket - 1) % n_slots)*slot_size, SLOT_HEADER + size, MPI_BYTE, mailbox_win);
+    MPI_Win_unlock(target_pe, mailbox_win);
+}
+
+/* Moves up to fan_out messages of the local mailbox to recv_buffers, oldest first, returns their number */
+static int
+mailbox_take(void)
+{
+    int i, m, ticket, oldest;
+    char *slot;
+
+    MPI_Win_lock(MPI_LOCK_EXCLUSIVE, mpi_pe, 0, mailbox_win);
+    for (m=0; m < fan_out; m++) {
+        oldest = -1;
+        for (i=0; i < n_slots; i++) {
+            ticket = *(int *)(mailbox + SLOT_HEADER + i*slot_size);
+            if ((ticket > 0) && ((oldest == -1) || (ticket < *(int *)(mailbox + SLOT_HEADER + oldest*slot_size))))
+                oldest = i;
+        }
+        if (oldest == -1)
+            break;
+        slot = mailbox + SLOT_HEADER + oldest*slot_size;
+        memcpy(recv_buffers + m*buffer_size, slot + SLOT_HEADER, buffer_size);
+        *(int *)slot = 0;
+    }
+    MPI_Win_unlock(mpi_pe, mailbox_win);
+    return m;
+}
+
+static void
+pack_individual(MCproblem *mcp, Individual *indv, char *buffer, int *position)
+{
+    int j, k, n_deleted = 0;
+
+    for (j=0; j < mcp->n_vars; j++)
+        if (indv->deletions[j] == DELETED_RXN)
+            deleted_rxns[n_deleted++] = j;
+    MPI_Pack(&n_deleted, 1, MPI_INT, buffer, buffer_size, position, MPI_COMM_WORLD);
+    MPI_Pack(deleted_rxns, n_deleted, MPI_INT, buffer, buffer_size, position, MPI_COMM_WORLD);
+    MPI_Pack(indv->objectives, mcp->n_models, MPI_DOUBLE, buffer, buffer_size, position, MPI_COMM_WORLD);
+    MPI_Pack(indv->penalty_objectives, mcp->n_models, MPI_DOUBLE, buffer, buffer_size, position, MPI_COMM_WORLD);
+    MPI_Pack(&(indv->crowding_distance), 1, MPI_DOUBLE, buffer, buffer_size, position, MPI_COMM_WORLD);
+    if (mcp->use_modules) {
+        for (k=0; k < mcp->n_models; k++) {
+            for (j=0; j < n_deleted; j++)
+                module_flags[j] = (indv->modules[k*mcp->n_vars + deleted_rxns[j]] == MODULE_RXN);
+            MPI_Pack(module_flags, n_deleted, MPI_C_BOOL, buffer, buffer_size, position, MPI_COMM_WORLD);
+        }
+    }
+}
+
+static void
+unpack_individual(MCproblem *mcp, Individual *indv, char *buffer, int *position, int has_modules)
+{
+    int j, k, n_deleted, n_modules, evaluate = 0;
+
+    set_blank_individual(mcp, indv);
+    MPI_Unpack(buffer, buffer_size, position, &n_deleted, 1, MPI_INT, MPI_COMM_WORLD);
+    MPI_Unpack(buffer, buffer_size, position, deleted_rxns, n_deleted, MPI_INT, MPI_COMM_WORLD);
+    for (j=0; j < n_deleted; j++)
+        indv->deletions[deleted_rxns[j]] = DELETED_RXN;
+    MPI_Unpack(buffer, buffer_size, position, indv->objectives, mcp->n_models, MPI_DOUBLE, MPI_COMM_WORLD);
+    MPI_Unpack(buffer, buffer_size, position, indv->penalty_objectives, mcp->n_models, MPI_DOUBLE, MPI_COMM_WORLD);
+    MPI_Unpack(buffer, buffer_size, position, &(indv->crowding_distance), 1, MPI_DOUBLE, MPI_COMM_WORLD);
+    if (has_modules) {
+        for (k=0; k < mcp->n_models; k++) {
+            MPI_Unpack(buffer, buffer_size, position, module_flags, n_deleted, MPI_C_BOOL, MPI_COMM_WORLD);
+            for (j=0, n_modules=0; j < n_deleted; j++) {
+                if (!module_flags[j])
+                    continue;
+                if (mcp->use_modules && (n_modules < mcp->beta))
+                    indv->modules[k*mcp->n_vars + deleted_rxns[j]] = MODULE_RXN;
+                else
+                    evaluate = 1;
+                n_modules++;
+            }
+        }
+    }
+    if (evaluate)
+        calculate_objectives(mcp, indv);
+    else
+        set_penalty_objectives(mcp, indv);
+}
+
+/* Returns 1 if messages have been received (point-to-point) or taken from the mailbox (one-sided) */
+int
+migration_status(MCproblem *mcp)
+{
+    int flag = 1, m = 0;
+    MPI_Status status;
+
+    if (n_sent == 0)
+        return 0;
+    if (mcp->migration_transport == MIGRATION_TRANSPORT_RMA) {
+        n_received = mailbox_take();
+        return n_received > 0;
+    }
+    /* Every arrived message is received, cycling over the fan_out buffers so the newest ones are kept */
+    while (1) {
+        MPI_Iprobe(MPI_ANY_SOURCE, MIGRATION_TAG, MPI_COMM_WORLD, &flag, &status);
+        if (!flag)
+            break;
+        MPI_Recv(recv_buffers + (m % fan_out)*buffer_size, buffer_size, MPI_PACKED, status.MPI_SOURCE, MIGRATION_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        m++;
+    }
+    n_received = (m < fan_out) ? m : fan_out;
+    return n_received > 0;
+}
+
+/* One generation of migration: initiates a migration when the schedule says so (and the sends of the previous one are done) and absorbs the messages that have arrived. Returns the number of messages received, then call migration_receive() or migration_complete(). begin is the start time of the run for verbose output. */
+int
+migration_step(MCproblem *mcp, Population *parent_population, int *receive_idx, unsigned int n_generations, double begin)
+{
+    int received;
+    double start = MPI_Wtime();
+
+    if (!migration_sending(mcp) && schedule_due(mcp, n_generations)) {
+        migration_initiate(mcp, parent_population, receive_idx);
+        if (mcp->verbose) printf("PE: %i Begin migration: %.0fs ...\n", mpi_pe, MPI_Wtime() - begin);
+    }
+    received = migration_status(mcp) ? n_received : 0;
+    schedule_record(MPI_Wtime() - start);
+    if (received && mcp->verbose)
+        printf("...PE: %i end migration: %.0fs ...\n", mpi_pe, MPI_Wtime() - begin);
+    return received;
+}
+
+/* Unpacks the received individuals into the first individuals of receive_population and returns their number. Call after migration_status() returns 1. */
+int
+migration_receive(MCproblem *mcp, Population *receive_population)
+{
+    int i, m, position, n_migrants, source_pe, stall, has_modules, n = 0;
+    char *buffer;
+
+    for (m=0; m < n_received; m++) {
+        buffer = recv_buffers + m*buffer_size;
+        position = 0;
+        MPI_Unpack(buffer, buffer_size, &position, &n_migrants, 1, MPI_INT, MPI_COMM_WORLD);
+        MPI_Unpack(buffer, buffer_size, &position, &source_pe, 1, MPI_INT, MPI_COMM_WORLD);
+        MPI_Unpack(buffer, buffer_size, &position, &stall, 1, MPI_INT, MPI_COMM_WORLD);
+        MPI_Unpack(buffer, buffer_size, &position, &has_modules, 1, MPI_INT, MPI_COMM_WORLD);
+        if (n_migrants != n_per_message) {
+            fprintf(stderr, "error: Received %i migrants but %i were expected, all islands must use the same migration size.\n", n_migrants, n_per_message);
+            exit(-1);
+        }
+        topology_observe(source_pe, stall);
+        for (i=0; i < n_migrants; i++)
+            unpack_individual(mcp, &(receive_population->indv[n++]), buffer, &position, has_modules);
+    }
+    n_received = 0;
+    return n;
+}
+
+/* Places the received individuals in parent_population */
+void
+migration_complete(MCproblem *mcp, Population *parent_population, Population *receive_population, int *receive_idx)
+{
+    int n = migration_receive(mcp, receive_population);
+    for (int i=0; i < n; i++)
+        copy_individual(mcp,  &(receive_population->indv[i]), &(parent_population->indv[receive_idx[i]]));
+}
+
+void
+migration_cancel(MCproblem *mcp)
+{
+    for (int i=0; i < n_requests; i++)
+        if (requests[i] != MPI_REQUEST_NULL)
+            MPI_Cancel(&requests[i]);
+}
@@ -43,7 +43,6 @@
 
 MCproblem read_problem(const char *problem_dir);
 bool is_not_candidate(Charlist *ncandfile, const char *rxnid);
-void write_population(MCproblem *mcp, Population *pop, char *out_population_path);
 void read_population(MCproblem *mcp, Population *pop, const char *population_path);
 int get_rxn_idx(MCproblem *mcp, const char *rxn_id);
 int get_model_idx(MCproblem *mcp, const char *model_id);
@@ -66,6 +65,35 @@ static char args_doc[] = "PROBLEM_DIR OUTPUT_FILE";
 
 /* Keys for options without short-options. */
 #define OPT_MINIMIZE_MR  1            /* --minimize_mr */
+#define OPT_SELECTION_ENGINE  2       /* --selection_engine */
+#define OPT_MOEAD  3                  /* --moead */
+#define OPT_METRICS  4                /* --metrics */
+#define OPT_STALL_GENERATIONS  5      /* --stall_generations */
+#define OPT_STALL_EPSILON  6          /* --stall_epsilon */
+#define OPT_REMOVE_DUPLICATES  7      /* --remove_duplicates */
+#define OPT_EPSILON_ARCHIVE  8        /* --epsilon_archive */
+#define OPT_EPSILON_DOMINANCE  9      /* --epsilon_dominance */
+#define OPT_LOCAL_SEARCH  10          /* --local_search */
+#define OPT_ADAPTIVE_OPERATORS  11    /* --adaptive_operators */
+#define OPT_GUIDED_MUTATION  12       /* --guided_mutation */
+#define OPT_EXPLORATION_FLOOR  13     /* --exploration_floor */
+#define OPT_ALPHA_REPAIR  14          /* --alpha_repair */
+#define OPT_SCREENING  15             /* --screening */
+#define OPT_SURROGATE  16             /* --surrogate */
+#define OPT_ENUMERATE  17             /* --enumerate */
+#define OPT_SEED_SCREENING  18        /* --seed_screening */
+#define OPT_MIGRATION_TRANSPORT  19   /* --migration_transport */
+#define OPT_ISLAND_CONFIG  20         /* --island_config */
+#define OPT_GLOBAL_ARCHIVE  21        /* --global_archive */
+#define OPT_FITNESS_CACHE  22         /* --fitness_cache */
+#define OPT_EVAL_STORE  23            /* --eval_store */
+#define OPT_MIGRATION_SCHEDULE  24    /* --migration_schedule */
+#define OPT_MIGRATION_PERIOD  25      /* --migration_period */
+#define OPT_CHECKPOINT  26            /* --checkpoint */
+#define OPT_RESUME  27                /* --resume */
+
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x) STRINGIFY_(x) /* Value of a macro as a string literal, for help texts */
 
 /* The options we understand. */
 static struct argp_option options[] = {
@@ -78,13 +106,39 @@ static struct argp_option options[] = {
   {"population_size",           's', "INT",       0, "Number of individuals" },
   {"crossover_probability",     'c', "FLOAT",       0, "Value between 0 and 1 that indicates the chances of crossover for each individual" },
   {"mutation_probability",      'm', "FLOAT",       0, "Value between 0 and 1 that indicates the chances of mutation for each individual" },
-  {"migration_interval",        'g', "INT",       0, "Number of generations in between migrations. Note that since migration is asynchronous, this value indicates when migration will be initiated (assuming no migrations are pending, in such case new migration attempts will not be made until ongoing migrations are completed)" },
+  {"migration_interval",        'g', "INT",       0, "Number of generations in between migrations. Note that since migration is asynchronous, this value indicates when migration will be initiated (assuming the sends of the previous migration are done, otherwise new migration attempts will not be made until they complete)" },
   {"migration_fraction",        'z', "FLOAT",     0, "Value between 0 and 1. Fraction of the population that will be transfered during migration" },
-  {"migration_topology",        'y', "INT",       0, "0: Ring topology, islands communicate as a directed ring graph; 1: Random topology, each migration will send and receive from a random island other than itself." },
+  {"migration_topology",        'y', "INT",       0, "0: Ring topology, islands communicate as a directed ring graph; 1: Random topology, each migration will send and receive from a random island other than itself; 2: Hypercube, one dimension per migration; 3: 2-D torus, one of the four grid neighbours per migration; 4: Small-world, ring plus two random shortcuts per island; 5: Broadcast, the elites are sent to all islands at every migration (migration_fraction is split among them); 6: Adaptive, migrants are sent preferentially to islands whose best objective values have stalled." },
   {"migration_policy",          'p', "INT",       0, "0: replace_bottom, the top individuals are sent and the bottom replaced, 1, :replace_sent, the top individuals are sent and replaced; 2, random, Random individuals are sent and replaced. Option 0 maintains the sent individuals in the original population, 1 or 2 do not." },
+  {"migration_transport",       OPT_MIGRATION_TRANSPORT, "INT", 0, "0: point-to-point, each island receives the migrants that have arrived every generation and waits until its sends are done before migrating again; 1: one-sided, each island puts migrants in the mailbox of the target island and absorbs those in its own mailbox every generation, so islands never wait for each other" },
+  {"migration_schedule",        OPT_MIGRATION_SCHEDULE, "INT", 0, "0 (default): a migration every migration_interval generations; 1: wall-clock, a migration every migration_period seconds, so islands with slow generations migrate as often as fast ones; 2: adaptive, as 1 but the period is shortened while the island front stalls and lengthened while it improves (between migration_period/8 and 8*migration_period), and lengthened while migration takes over 5% of the island wall time" },
+  {"migration_period",          OPT_MIGRATION_PERIOD, "SECONDS", 0, "Wall-clock time between migrations with migration_schedule 1 or 2 (default 30)" },
+  {"island_config",             OPT_ISLAND_CONFIG, "FILE", 0, "Per island (MPI PE) parameters. Each line of FILE is an island selector, '*' (all), N, N-M (range) or %M=R (islands whose index modulo M is R), followed by KEY=VALUE pairs that override the command line for the selected islands (later lines take precedence). KEY is one of alpha, beta, population_size, crossover_probability, mutation_probability, selection_engine, moead (0 or 1), local_search or adaptive_operators. Lines starting with # are ignored. An island running moead cannot use options it does not support (see --moead). The migration size is computed from the command line population size in all islands" },
+  {"global_archive",            OPT_GLOBAL_ARCHIVE, "INT", 0, "With MPI, every INT generations each island sends its non-dominated individuals to PE 0, which keeps the non-dominated designs of all islands and writes them to OUTPUT_FILE at the end of the run (the island populations are still written to OUTPUT_FILE_<PE>). 0 (default) disables the global archive" },
   {"max_run_time",              't', "INT",       0, "Wall-clock run time in seconds for the main MOEA loop (allow some extra time for IO)" },
   {"n_generations",             'n', "INT",       0, "Maximum number of generations" },
   {"minimize_modules",               OPT_MINIMIZE_MR ,0, 0, "Run module reaction minimizer instead of MOEA"},
+  {"enumerate",                 OPT_ENUMERATE, 0, 0, "Evaluate all designs with up to alpha deletions (beta must be 0) instead of running the MOEA and write the non-dominated ones to OUTPUT_FILE. Until it completes, each MPI PE writes the designs it keeps to OUTPUT_FILE_<PE>.part every minute. Only practical for small alpha (1-3)"},
+  {"seed_screening",            OPT_SEED_SCREENING, "N", 0, "Before initializing the population evaluate all single deletions, and the double deletions among the N best of them, to seed part of the initial population and to never delete reactions whose deletion is lethal in all models (0 disables it)"},
+  {"fitness_cache",             OPT_FITNESS_CACHE, "MB", 0, "Keep the objectives of solved (production network, knockout set) pairs in a cache of MB MiB per PE, shared by all islands through MPI one-sided communication, and skip the LPs of pairs already solved by any island. 0 (default) disables the cache" },
+  {"checkpoint",                OPT_CHECKPOINT, "SECONDS", 0, "Write the state of each island (population, objectives, RNG and counters) to OUTPUT_FILE_<PE>.ckpt0 or .ckpt1 every SECONDS of wall time, at the end of the run, and on SIGUSR1 or SIGTERM (the run then ends normally). 0 (default) disables checkpoints. Not available with --moead" },
+  {"resume",                    OPT_RESUME, 0, 0, "Continue the run from the last checkpoint written by all islands for OUTPUT_FILE, without evaluating the population again. The number of PEs and the parameters must be those of the checkpointed run, the generation and run time limits count from its start" },
+  {"eval_store",                OPT_EVAL_STORE, "FILE", 0, "Load the objectives of (production network, knockout set) pairs solved by earlier runs on the same problem from FILE and append those solved in this run, so they are not solved again. FILE is created if it does not exist and refused if it was built for another problem. The objectives of the initial population file are also used, in this run only" },
+  {"moead",                     OPT_MOEAD, 0, 0, "Run the MOEA/D decomposition engine instead of NSGA-II/III. Each individual is the incumbent of a weighted Tchebycheff subproblem and children are warm-started from the LP basis of their subproblem incumbent. Not compatible with --checkpoint, --resume, --screening, --surrogate, --local_search, --adaptive_operators, --remove_duplicates or --selection_engine=1"},
+  {"metrics",                   OPT_METRICS, 0, 0, "Every " STRINGIFY(PRINT_INTERVAL) " generations (the print interval) record hypervolume, front size, spread, and generational distance (with respect to the previous record) of the population in OUTPUT_FILE.metrics.csv (OUTPUT_FILE.metrics_<PE>.csv with MPI)"},
+  {"stall_generations",         OPT_STALL_GENERATIONS, "INT", 0, "Stop when, in all islands, the front has not improved for this many generations: no relative hypervolume increase above stall_epsilon and no new non-dominated objective vectors. Checked every " STRINGIFY(PRINT_INTERVAL) " generations (the print interval). 0 (default) disables this criterion" },
+  {"stall_epsilon",             OPT_STALL_EPSILON, "FLOAT", 0, "Minimum relative hypervolume increase considered an improvement by the stall criterion. Note that for more than 4 production networks the hypervolume is a Monte-Carlo estimate, so this should stay above its noise (~0.005)" },
+  {"remove_duplicates",         OPT_REMOVE_DUPLICATES, 0, 0, "Offspring with the same genome (deletions and modules) as a parent or another offspring are re-mutated before evaluation, and duplicated individuals are only kept by environmental selection if there are not enough unique ones. Not available with --moead"},
+  {"epsilon_archive",           OPT_EPSILON_ARCHIVE, 0, 0, "Keep an archive with at most one individual per box of side 0.015 (objective tolerance) of the objective space and write it to OUTPUT_FILE.archive (OUTPUT_FILE.archive_<PE> with MPI)"},
+  {"epsilon_dominance",         OPT_EPSILON_DOMINANCE, 0, 0, "Use epsilon-dominance (boxes of side 0.015) instead of plain dominance in selection"},
+  {"local_search",              OPT_LOCAL_SEARCH, "INT", 0, "Every INT generations, improve a few non-dominated individuals by local search over single deletion additions, removals, swaps and module toggles. 0 (default) disables local search. Not available with --moead" },
+  {"adaptive_operators",        OPT_ADAPTIVE_OPERATORS, 0, 0, "Adapt, in each island, the probabilities of crossover (none, two point, uniform), mutation (none, bit flip, swap) and of the number of mutated sites to the survival of their offspring. crossover_probability and mutation_probability set the initial probabilities of applying each class. Not available with --moead"},
+  {"guided_mutation",           OPT_GUIDED_MUTATION, 0, 0, "Sample mutation sites from the deletion and module frequencies of the non-dominated individuals (all subproblem incumbents with --moead), instead of uniformly. Missing individuals of the initial population are also sampled from the frequencies of those read"},
+  {"exploration_floor",         OPT_EXPLORATION_FLOOR, "FLOAT", 0, "Value between 0 and 1. Fraction of the guided mutation sampling spread uniformly over all reactions (default 0.2)" },
+  {"alpha_repair",              OPT_ALPHA_REPAIR, 0, 0, "Keep offspring within alpha deletions: excess deletions are removed at random after crossover and mutation swaps deletions once alpha is reached. By default offspring above alpha are evaluated and their objectives divided by their number of deletions"},
+  {"screening",                 OPT_SCREENING, "INT", 0, "Two tier evaluation of offspring: a first solve is limited to INT simplex iterations and offspring whose provisional objectives are clearly dominated by the last front of the parent population are discarded without an exact solve. 0 (default) disables screening. Not available with --moead" },
+  {"surrogate",                 OPT_SURROGATE, "INT", 0, "Create INT times more offspring than needed and only evaluate the most promising ones according to a k-nearest neighbours model of the objectives trained with all evaluated individuals. 0 or 1 (default) disables the surrogate. NSGA-II/III only, not available with --moead" },
+  {"selection_engine",          OPT_SELECTION_ENGINE, "INT", 0, "0: NSGA-II, the last front is truncated by crowding distance; 1: NSGA-III, the last front is truncated by niching around structured reference points, recommended for many (more than 3-4) production networks. Must be 0 with --moead" },
   { 0 }
 };
 
@@ -92,12 +146,14 @@ static struct argp_option options[] = {
 struct arguments
 {
   char *args[2];     /* arg1 and arg2 */
-  char *objective_type, *initial_population;
-  int alpha, beta, seed, max_run_time, migration_interval, population_size, verbose, n_generations, migration_policy, migration_topology, minimize_modules;
-  float crossover_probability, mutation_probability, migration_fraction;
+  char *objective_type, *initial_population, *island_config, *eval_store;
+  int alpha, beta, seed, max_run_time, migration_interval, population_size, verbose, n_generations, migration_policy, migration_topology, migration_transport, migration_schedule, global_archive, minimize_modules, selection_engine, moead, metrics, stall_generations, remove_duplicates, epsilon_archive, epsilon_dominance, local_search, adaptive_operators, guided_mutation, alpha_repair, screening, surrogate, enumerate, seed_screening, fitness_cache, resume;
+  float crossover_probability, mutation_probability, migration_fraction, stall_epsilon, exploration_floor, migration_period, checkpoint;
 };
 
 void load_parameters(MCproblem *mcp, struct arguments *arguments);
+static int island_selected(const char *selector);
+static void read_island_config(struct arguments *arguments);
 
 /* Parse a single option. */
 static error_t
@@ -157,6 +213,84 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case OPT_MINIMIZE_MR:
       arguments->minimize_modules = 1;
       break;
+    case OPT_CHECKPOINT:
+      arguments->checkpoint = atof(arg);
+      break;
+    case OPT_RESUME:
+      arguments->resume = 1;
+      break;
+    case OPT_ENUMERATE:
+      arguments->enumerate = 1;
+      break;
+    case OPT_SEED_SCREENING:
+      arguments->seed_screening = atoi(arg);
+      break;
+    case OPT_MIGRATION_TRANSPORT:
+      arguments->migration_transport = atoi(arg);
+      break;
+    case OPT_MIGRATION_SCHEDULE:
+      arguments->migration_schedule = atoi(arg);
+      break;
+    case OPT_MIGRATION_PERIOD:
+      arguments->migration_period = atof(arg);
+      break;
+    case OPT_ISLAND_CONFIG:
+      arguments->island_config = arg;
+      break;
+    case OPT_EVAL_STORE:
+      arguments->eval_store = arg;
+      break;
+    case OPT_FITNESS_CACHE:
+      arguments->fitness_cache = atoi(arg);
+      break;
+    case OPT_GLOBAL_ARCHIVE:
+      arguments->global_archive = atoi(arg);
+      break;
+    case OPT_MOEAD:
+      arguments->moead = 1;
+      break;
+    case OPT_METRICS:
+      arguments->metrics = 1;
+      break;
+    case OPT_STALL_GENERATIONS:
+      arguments->stall_generations = atoi(arg);
+      break;
+    case OPT_STALL_EPSILON:
+      arguments->stall_epsilon = atof(arg);
+      break;
+    case OPT_REMOVE_DUPLICATES:
+      arguments->remove_duplicates = 1;
+      break;
+    case OPT_EPSILON_ARCHIVE:
+      arguments->epsilon_archive = 1;
+      break;
+    case OPT_EPSILON_DOMINANCE:
+      arguments->epsilon_dominance = 1;
+      break;
+    case OPT_LOCAL_SEARCH:
+      arguments->local_search = atoi(arg);
+      break;
+    case OPT_ADAPTIVE_OPERATORS:
+      arguments->adaptive_operators = 1;
+      break;
+    case OPT_GUIDED_MUTATION:
+      arguments->guided_mutation = 1;
+      break;
+    case OPT_EXPLORATION_FLOOR:
+      arguments->exploration_floor = atof(arg);
+      break;
+    case OPT_ALPHA_REPAIR:
+      arguments->alpha_repair = 1;
+      break;
+    case OPT_SCREENING:
+      arguments->screening = atoi(arg);
+      break;
+    case OPT_SURROGATE:
+      arguments->surrogate = atoi(arg);
+      break;
+    case OPT_SELECTION_ENGINE:
+      arguments->selection_engine = atoi(arg);
+      break;
 
     case ARGP_KEY_ARG:
       if (state->arg_num >= 2) /* Too many arguments. */
@@ -178,9 +312,80 @@ parse_opt (int key, char *arg, struct argp_state *state)
 /* Our argp parser. */
 static struct argp argp = { options, parse_opt, args_doc, doc };
 
+/* Returns 1 if the island selector of an island configuration line includes this PE */
+static int
+island_selected(const char *selector)
+{
+    int first, last;
+
+    if (strcmp(selector, "*") == 0)
+        return 1;
+    if (sscanf(selector, "%%%d=%d", &first, &last) == 2)
+        return (first > 0) && (mpi_pe % first == last);
+    if (sscanf(selector, "%d-%d", &first, &last) == 2)
+        return (mpi_pe >= first) && (mpi_pe <= last);
+    if (sscanf(selector, "%d", &first) == 1)
+        return mpi_pe == first;
+    fprintf (stderr, "error: invalid island selector '%s' in island configuration file\n", selector);
+    exit(-1);
+}
+
+/* Overrides the arguments of this PE with those of the island configuration file */
+static void
+read_island_config(struct arguments *arguments)
+{
+    char line[1024], *token, *value;
+    int lc = 0;
+
+    OPENFILER(arguments->island_config)
+    while (fgets(line, sizeof line, fp) != NULL) {
+        lc++;
+        token = strtok(line, " \t\r\n");
+        if ((token == NULL) || (token[0] == '#') || !island_selected(token))
+            continue;
+        while ((token = strtok(NULL, " \t\r\n")) != NULL) {
+            if ((value = strchr(token, '=')) == NULL) {
+                fprintf (stderr, "error: expected KEY=VALUE, found '%s' in line %i of island configuration file\n", token, lc);
+                exit(-1);
+            }
+            *value++ = '\0';
+            if (strcmp(token, "alpha") == 0)
+                arguments->alpha = atoi(value);
+            else if (strcmp(token, "beta") == 0)
+                arguments->beta = atoi(value);
+            else if (strcmp(token, "population_size") == 0)
+                arguments->population_size = atoi(value);
+            else if (strcmp(token, "crossover_probability") == 0)
+                arguments->crossover_probability = atof(value);
+            else if (strcmp(token, "mutation_probability") == 0)
+                arguments->mutation_probability = atof(value);
+            else if (strcmp(token, "selection_engine") == 0)
+                arguments->selection_engine = atoi(value);
+            else if (strcmp(token, "moead") == 0)
+                arguments->moead = atoi(value);
+            else if (strcmp(token, "local_search") == 0)
+                arguments->local_search = atoi(value);
+            else if (strcmp(token, "adaptive_operators") == 0)
+                arguments->adaptive_operators = atoi(value);
+            else {
+                fprintf (stderr, "error: unknown parameter '%s' in line %i of island configuration file\n", token, lc);
+                exit(-1);
+            }
+        }
+    }
+    CLOSEFILE
+}
+
 void
 load_parameters(MCproblem *mcp, struct arguments *arguments)
 {
+    const char *unsupported;
+
+    /* Same in all islands, so it is set before the island configuration */
+    mcp->migration_size = (int)(arguments->migration_fraction * arguments->population_size);
+    if (arguments->island_config[0] != '\0')
+        read_island_config(arguments);
+
     mcp->verbose = arguments->verbose;
     strcpy(mcp->objective_type, arguments->objective_type);
     mcp->alpha = arguments->alpha;
@@ -190,13 +395,77 @@ load_parameters(MCproblem *mcp, struct arguments *arguments)
     mcp->crossover_probability = arguments->crossover_probability;
     mcp->mutation_probability = arguments->mutation_probability;
     mcp->migration_interval = arguments->migration_interval;
-    mcp->migration_size = (int)(arguments->migration_fraction * arguments->population_size);
     mcp->max_run_time = arguments->max_run_time;
     mcp->n_generations = arguments->n_generations;
     mcp->migration_topology = arguments->migration_topology;
     mcp->migration_policy = arguments->migration_policy;
+    mcp->migration_transport = arguments->migration_transport;
+    mcp->migration_schedule = arguments->migration_schedule;
+    mcp->migration_period = arguments->migration_period;
+    mcp->global_archive_interval = (mpi_comm_size > 1) ? arguments->global_archive : 0;
+    strcpy(mcp->global_archive_path, arguments->args[1]);
+    mcp->selection_engine = arguments->selection_engine;
+    mcp->stall_generations = arguments->stall_generations;
+    mcp->remove_duplicates = arguments->remove_duplicates;
+    mcp->epsilon_dominance = arguments->epsilon_dominance;
+    mcp->local_search_interval = arguments->local_search;
+    mcp->adaptive_operators = arguments->adaptive_operators;
+    mcp->guided_mutation = arguments->guided_mutation;
+    mcp->exploration_floor = arguments->exploration_floor;
+    if ((mcp->exploration_floor < 0) || (mcp->exploration_floor > 1)) {
+        fprintf(stderr, "error: The exploration floor must be between 0 and 1.\n");
+        exit(-1);
+    }
+    mcp->alpha_repair = arguments->alpha_repair;
+    mcp->screening_it_lim = arguments->screening;
+    mcp->surrogate_factor = arguments->surrogate;
+    mcp->n_seed_singles = arguments->seed_screening;
+    mcp->fitness_cache_mb = arguments->fitness_cache;
+    strcpy(mcp->eval_store_path, arguments->eval_store);
+    mcp->checkpoint_interval = arguments->checkpoint;
+    mcp->checkpoint_resume = arguments->resume;
+    strcpy(mcp->checkpoint_path, arguments->args[1]);
+    /* Checked after the island configuration, so on the combination each island runs */
+    if (arguments->moead) {
+        unsupported = NULL;
+        if ((mcp->checkpoint_interval > 0) || mcp->checkpoint_resume)
+            unsupported = "Checkpoints are";
+        else if (mcp->screening_it_lim > 0)
+            unsupported = "Screening is";
+        else if (mcp->surrogate_factor > 1)
+            unsupported = "The surrogate is";
+        else if (mcp->local_search_interval > 0)
+            unsupported = "Local search is";
+        else if (mcp->adaptive_operators)
+            unsupported = "Adaptive operators are";
+        else if (mcp->remove_duplicates)
+            unsupported = "Duplicate removal is";
+        else if (mcp->selection_engine != SELECTION_ENGINE_NSGA2)
+            unsupported = "The NSGA-III selection engine is";
+        if (unsupported != NULL) {
+            fprintf(stderr, "error: %s not supported by the MOEA/D engine (island %i).\n", unsupported, mpi_pe);
+            exit(-1);
+        }
+    }
+    mcp->blacklist = NULL;
+    mcp->stall_epsilon = arguments->stall_epsilon;
+    if (!arguments->metrics)
+        mcp->metrics_path[0] = '\0';
+    else if (mpi_comm_size > 1)
+        sprintf(mcp->metrics_path, "%s.metrics_%i.csv", arguments->args[1], mpi_pe);
+    else
+        sprintf(mcp->metrics_path, "%s.metrics.csv", arguments->args[1]);
+    if (!arguments->epsilon_archive)
+        mcp->archive_path[0] = '\0';
+    else if (mpi_comm_size > 1)
+        sprintf(mcp->archive_path, "%s.archive_%i", arguments->args[1], mpi_pe);
+    else
+        sprintf(mcp->archive_path, "%s.archive", arguments->args[1]);
     /* Indicate if module reactions are used */
     mcp->use_modules = arguments->beta > 0;
+    kernels_init(mcp);
+    if (mpi_comm_size > 1)
+        topology_init(mcp);
 }
 
 /* CLI done */
@@ -224,6 +493,7 @@ read_problem(const char *problem_dir_path)
     }
 
     allocate_MCproblem(&mcp, n_models, cand_file.n);
+    mcp.basis_size = 0;
 
     /* Read deletion candidate names */
     for (j=0; j < mcp.n_vars; j++)
@@ -306,6 +576,10 @@ read_problem(const char *problem_dir_path)
         /* Objective values without deletions */
         glp_simplex(lp->P, &param);
         lp->no_deletion_objective = glp_get_col_prim(lp->P, lp->prod_col_idx)/lp->max_prod_growth; //FIXME: Assumes wGCP. Needs to be calculated after parameters are parsed.
+
+        /* Layout of flat basis arrays used for warm-starts */
+        lp->basis_offset = mcp.basis_size;
+        mcp.basis_size += glp_get_num_rows(lp->P) + glp_get_num_cols(lp->P);
     }
 
     return mcp;
@@ -335,7 +609,7 @@ write_population(MCproblem *mcp, Population *pop, char *out_population_path)
     }
 
     fprintf(f, "#METADATA\n");
-    fprintf(f, "population_size=%d\n", mcp->population_size);
+    fprintf(f, "population_size=%zu\n", pop->size);
     fprintf(f, "alpha=%d\n", mcp->alpha);
     fprintf(f, "beta=%d\n", mcp->beta);
 
@@ -393,6 +667,7 @@ get_model_idx(MCproblem *mcp, const char *model_id)
 /* Loads a population file:
  * Notes:
  *      - Objectives could be calculated here and checked for consitency, currently objectives are not calculated until the moea procdure.
+ *      - Objectives read are only added to the evaluation store (if used), they are rounded to the precision of the file.
  */
 void
 read_population(MCproblem *mcp, Population *pop, const char *population_path)
@@ -400,10 +675,12 @@ read_population(MCproblem *mcp, Population *pop, const char *population_path)
     int population_size, alpha, beta;
     char buff[1000]; //TODO: Is there a way to detect overflow of this buffer?
     int lc = 0;
-    bool in_deletions = 0, in_modules = 0;
+    bool in_deletions = 0, in_modules = 0, in_objectives = 0;
     int indv_idx = -1, rxn_idx, model_idx;
+    double objective;
     Individual *indv ={NULL};
     char *token, *string, *tofree=NULL;
+    pcg32_random_t rng;
 
     FILE *fp = NULL;
     if (!(fp = fopen (population_path, "r"))) {
@@ -441,6 +718,7 @@ read_population(MCproblem *mcp, Population *pop, const char *population_path)
         }
         if(strcmp(buff, "#DELETIONS") == 0) {
             in_deletions = 1;
+            in_objectives = 0;
             continue;
         }
         if(strcmp(buff, "#MODULES") == 0) {
@@ -450,8 +728,11 @@ read_population(MCproblem *mcp, Population *pop, const char *population_path)
         }
         if(strcmp(buff, "#OBJECTIVES") == 0) {
             in_modules = 0;
+            in_objectives = 1;
             continue;
         }
+        if(strcmp(buff, "#ENDFILE") == 0)
+            break;
 
         if (in_deletions) {
             rxn_idx = get_rxn_idx(mcp, buff);
@@ -468,14 +749,33 @@ read_population(MCproblem *mcp, Population *pop, const char *population_path)
                 indv->modules[model_idx*mcp->n_vars + rxn_idx] = MODULE_RXN;
             }
         }
+
+        if (in_objectives) { /* Only used by the evaluation store (not appended to its file), the population is evaluated again */
+            token = strchr(buff, ',');
+            assert(token != NULL);
+            *token = '\0';
+            if (sscanf(token + 1, "%lf", &objective) == 1)
+                indv->objectives[get_model_idx(mcp, buff)] = objective;
+        }
     }
     if (fp) fclose(fp);
     if(tofree) free(tofree);
 
-    /* Add extra individuals if needed */
+    /* Objectives of a file written with modules only hold when modules are used */
     indv_idx++;
+    if ((mcp->eval_store_path[0] != '\0') && (mcp->use_modules || (beta == 0)))
+        for (int i=0; (i < indv_idx) && (i < (int)mcp->population_size); i++)
+            eval_store_add_individual(mcp, &(pop->indv[i]));
+
+    /* Add extra individuals if needed */
+    if (mcp->guided_mutation && (indv_idx > 0) && (indv_idx < mcp->population_size))
+        gene_model_update(mcp, pop, indv_idx, 0);
     while(indv_idx < mcp->population_size){
-        set_random_individual(mcp, &(pop->indv[indv_idx]));
+        set_rng_stream(mcp, &rng, INIT_RNG_ROUND, indv_idx);
+        if (mcp->guided_mutation && (indv_idx > 0))
+            set_gene_model_individual(mcp, &(pop->indv[indv_idx]), &rng);
+        else
+            set_random_individual(mcp, &(pop->indv[indv_idx]), &rng);
         indv_idx++;
     }
 
@@ -493,6 +793,8 @@ main (int argc, char **argv)
     /* Default values. */
     arguments.verbose = 1;
     arguments.initial_population = "";
+    arguments.island_config = "";
+    arguments.eval_store = "";
     arguments.objective_type = "wgcp";
     arguments.alpha = 5;
     arguments.beta = 0;
@@ -506,7 +808,31 @@ main (int argc, char **argv)
     arguments.n_generations = 500;
     arguments.migration_policy = 0;
     arguments.migration_topology = 0;
+    arguments.migration_transport = MIGRATION_TRANSPORT_P2P;
+    arguments.migration_schedule = MIGRATION_SCHEDULE_GENERATIONS;
+    arguments.migration_period = 30;
+    arguments.global_archive = 0;
     arguments.minimize_modules = 0;
+    arguments.selection_engine = SELECTION_ENGINE_NSGA2;
+    arguments.moead = 0;
+    arguments.metrics = 0;
+    arguments.stall_generations = 0;
+    arguments.remove_duplicates = 0;
+    arguments.epsilon_archive = 0;
+    arguments.epsilon_dominance = 0;
+    arguments.local_search = 0;
+    arguments.adaptive_operators = 0;
+    arguments.guided_mutation = 0;
+    arguments.exploration_floor = 0.2;
+    arguments.alpha_repair = 0;
+    arguments.screening = 0;
+    arguments.surrogate = 0;
+    arguments.enumerate = 0;
+    arguments.checkpoint = 0;
+    arguments.resume = 0;
+    arguments.seed_screening = 0;
+    arguments.fitness_cache = 0;
+    arguments.stall_epsilon = 0.01;
 
     argp_parse (&argp, argc, argv, 0, 0, &arguments);
 
@@ -526,13 +852,42 @@ main (int argc, char **argv)
     load_parameters(&mcp, &arguments);
     fflush(stdout);
 
+    if (arguments.enumerate) { /* No population is needed */
+        if (arguments.island_config[0] != '\0') {
+            fprintf (stderr, "error: Enumeration does not support island configurations.\n");
+            exit(-1);
+        }
+        run_enumeration(&mcp, arguments.args[1]);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        return(0);
+    }
+
+    if (mcp.eval_store_path[0] != '\0')
+        eval_store_init(&mcp, arguments.args[0]);
+    if (mcp.fitness_cache_mb > 0)
+        fitness_cache_init(&mcp);
+
     /* Seed global RNG */
     pcg32_srandom(mcp.seed+mpi_pe, 54u);
 
+    if (mcp.guided_mutation)
+        gene_model_init(&mcp);
+    if ((mcp.n_seed_singles > 0) && !mcp.checkpoint_resume) /* The blacklist is restored from the checkpoint */
+        seeding_init(&mcp);
+
     /* Intialize population */
     Population *initial_population = malloc(sizeof(Population));
     allocate_population(&mcp, initial_population, mcp.population_size);
-    if (arguments.initial_population[0] == '\0') {
+    if (mcp.checkpoint_resume) {
+        if (mpi_pe == 0) printf("(PE=0) Resuming from the checkpoints of %s\n", arguments.args[1]);
+        set_blank_population(&mcp, initial_population); /* Filled by checkpoint_load() */
+    }
+    else if ((arguments.initial_population[0] == '\0') && (mcp.n_seed_singles > 0)) {
+        if (mpi_pe == 0)  printf("(PE=0) Initial population not specified (initialize from deletion screening)\n");
+        set_seeded_population(&mcp, initial_population);
+    }
+    else if (arguments.initial_population[0] == '\0') {
         if (mpi_pe == 0)  printf("(PE=0) Initial population not specified (initialize at random)\n");
         set_random_population(&mcp, initial_population);
     }
@@ -551,6 +906,8 @@ main (int argc, char **argv)
             }
         minimize_mr(&mcp, initial_population);
     }
+    else if (arguments.moead)
+        run_moead(&mcp, initial_population);
     else
         run_moea(&mcp, initial_population);
 
@@ -568,6 +925,16 @@ main (int argc, char **argv)
 
     /* Cleanup */
     free_population(&mcp, initial_population);
+    if (mcp.guided_mutation)
+        gene_model_free();
+    if (mcp.n_seed_singles > 0)
+        seeding_free(&mcp);
+    if (mpi_comm_size > 1)
+        topology_free();
+    if (mcp.fitness_cache_mb > 0)
+        fitness_cache_free(&mcp);
+    if (mcp.eval_store_path[0] != '\0')
+        eval_store_free(&mcp);
     MPI_Finalize();
 
     return(0);
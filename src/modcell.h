@@ -12,6 +12,8 @@
 #define A_DOMINATES_B 1
 #define B_DOMINATES_A -1
 #define NONDOMINATED 0
+#define NO_OPERATORS -1
+#define INIT_RNG_ROUND 0 /* RNG round (see set_rng_stream()) of the initial population, later rounds are used by variation */
 
 /* Parameter notation */
 #define MIGRATION_POLICY_REPLACE_BOTTOM 0
@@ -19,6 +21,18 @@
 #define MIGRATION_POLICY_RANDOM 2
 #define MIGRATION_TOPOLOGY_RING 0
 #define MIGRATION_TOPOLOGY_RANDOM 1
+#define MIGRATION_TOPOLOGY_HYPERCUBE 2
+#define MIGRATION_TOPOLOGY_TORUS 3
+#define MIGRATION_TOPOLOGY_SMALL_WORLD 4
+#define MIGRATION_TOPOLOGY_BROADCAST 5
+#define MIGRATION_TOPOLOGY_ADAPTIVE 6
+#define MIGRATION_TRANSPORT_P2P 0
+#define MIGRATION_TRANSPORT_RMA 1
+#define MIGRATION_SCHEDULE_GENERATIONS 0
+#define MIGRATION_SCHEDULE_WALL_CLOCK 1
+#define MIGRATION_SCHEDULE_ADAPTIVE 2
+#define SELECTION_ENGINE_NSGA2 0
+#define SELECTION_ENGINE_NSGA3 1
 
 /* Definitions */
 #define INF 1.0e14 		/* A value to simulate infinity */
@@ -51,6 +65,7 @@ typedef struct {
 	double *penalty_objectives; 	/* [n_models] */
 	int rank; // This is currently unused.
 	double crowding_distance;
+	int operators; 			/* Variation operators that created this offspring (see adaptive.c) or NO_OPERATORS */
 } Individual;
 
 typedef struct Population{
@@ -68,6 +83,7 @@ typedef struct {
 	int bio_col_idx; 	/* Index of the biomass formation reaction */
 	double max_prod_growth; /* Maximum rate of product synthesis for growth state */
 	double no_deletion_objective; /* Objective value when no deletions are present */
+	size_t basis_offset; 	/* Offset of this model in a flat basis array (see save_basis()) */
 } LPproblem;
 
 typedef struct {
@@ -79,6 +95,7 @@ typedef struct {
 	char **model_names; 	/* [nvars] */
 	LPproblem *lps; 	/* [n_models] Contains everything needed to calculate an individuals fitness function */
 	char **individual2id; 	/* [nvars] Maps individual indices to reaction ID. */
+	size_t basis_size; 	/* Length of a flat array holding the row and column statuses of all models */
 
 	/* MOEA */
     	size_t n_vars;
@@ -88,18 +105,66 @@ typedef struct {
 	double crossover_probability;
 	double mutation_probability;
 	double max_run_time; 	/* maximum run time in seconds */
+	unsigned int stall_generations; /* Stop once the front has not improved in this many generations (0 disables) */
+	double stall_epsilon; 	/* Minimum relative hypervolume increase considered an improvement */
+	unsigned int selection_engine; /* SELECTION_ENGINE_NSGA2 or SELECTION_ENGINE_NSGA3 */
+	int remove_duplicates; 	/* Re-mutate duplicated offspring and move duplicates to the back during environmental selection */
+	int epsilon_dominance; 	/* Compare objectives in boxes of side OBJ_TOL in find_domination() */
+	unsigned int local_search_interval; /* Generations between local search calls (0 disables) */
+	int adaptive_operators; /* Adapt variation operator probabilities from offspring survival */
+	int guided_mutation; 	/* Sample mutation sites and new individuals from gene_model.c */
+	double exploration_floor; /* Fraction of the guided sampling probability spread uniformly over all reactions */
+	int alpha_repair; 	/* Variation keeps at most alpha deletions instead of relying on the objective penalty */
+	unsigned int screening_it_lim; /* Simplex iteration limit of the offspring screening solve (0 disables screening) */
+	unsigned int surrogate_factor; /* Offspring candidates created per evaluated offspring and filtered by the surrogate model (0 or 1 disables it) */
+	unsigned int n_seed_singles; /* Best single deletions combined into double deletions by the startup deletion screening (0 disables the screening) */
+	unsigned int fitness_cache_mb; /* Size in MiB of the slice of the evaluation cache held by each PE (0 disables the cache) */
+	bool *blacklist; 	/* [n_vars] Reactions never deleted because their deletion is lethal in all models (see seeding.c), NULL if not used */
 
 	/* Parallelization  */
     	unsigned int migration_interval;
     	unsigned int migration_size;
     	unsigned int migration_policy;
     	unsigned int migration_topology;
+    	unsigned int migration_transport;
+    	unsigned int migration_schedule;
+    	double migration_period; /* Seconds, wall-clock and adaptive schedules */
+    	unsigned int global_archive_interval; /* Generations between contributions of each island to the global archive (0 disables it) */
 
 	/* Other */
+	char metrics_path[256]; /* Per PE front metrics file, empty if metrics are not recorded */
+	char archive_path[256]; /* Per PE epsilon archive population file, empty if the archive is not used */
+	char global_archive_path[256]; /* Global archive population file, written by PE 0 */
+	char eval_store_path[256]; /* Persistent evaluation store file, empty if the store is not used */
+	double checkpoint_interval; /* Seconds between checkpoints of the island state (0 disables them) */
+	int checkpoint_resume; 	/* Continue from the last checkpoint instead of the initial population */
+	char checkpoint_path[256]; /* Checkpoints are written to <checkpoint_path>_<PE>.ckpt<0|1> */
 	int verbose;
     	int use_modules;  /* = hmcp.beta > 0 */
 } MCproblem;
 
+typedef struct { /* Open addressing hash set of genomes (deletions + modules) */
+	uint64_t *hashes; 	/* [capacity] 0 marks an empty slot */
+	Individual **indvs; 	/* [capacity] */
+	size_t capacity; 	/* Power of two */
+} GenomeSet;
+
+typedef struct {
+	size_t front_size; 	/* Number of distinct non-dominated objective vectors */
+	size_t new_points; 	/* Non-dominated vectors not weakly dominated by any previously recorded front */
+	double hypervolume;
+	double spread;
+	double generational_distance; /* With respect to the front of the previous evaluation */
+} FrontMetrics;
+
+typedef struct { /* Specialized kernels (see kernels.c) */
+	void (*copy_individual)(MCproblem *mcp, Individual *indv_source, Individual *indv_dest);
+	void (*crossover_segment)(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, int site1, int site2);
+	void (*crossover_uniform)(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng);
+	int (*find_domination)(MCproblem *mcp, Individual *indv_a, Individual *indv_b);
+	int (*set_change_bound)(MCproblem *mcp, Individual *indv, int k, int *change_bound);
+} Kernels;
+
 typedef struct item { /* list item */
      int index;
      struct item *prev, *next;
@@ -112,22 +177,173 @@ void free_population(MCproblem *mcp, Population *pop);
 void allocate_individual(MCproblem *mcp, Individual *indv);
 void free_individual(MCproblem *mcp, Individual *indv);
 void set_random_population(MCproblem *mcp, Population *pop);
-void set_random_individual(MCproblem *mcp,  Individual *indv);
+void set_random_individual(MCproblem *mcp,  Individual *indv, pcg32_random_t *rng);
 void set_blank_population(MCproblem *mcp, Population *pop);
 void set_blank_individual(MCproblem *mcp,  Individual *indv);
 
 /* functions.c */
 void calculate_objectives(MCproblem *mcp, Individual *indv);
-void crossover(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2);
-void mutation(MCproblem *mcp, Individual *indv);
-void enforce_module_constraints(MCproblem *mcp, Individual *indv);
+void calculate_objectives_basis(MCproblem *mcp, Individual *indv, unsigned char *basis_in, unsigned char *basis_out);
+void save_basis(MCproblem *mcp, int k, unsigned char *basis);
+void load_basis(MCproblem *mcp, int k, unsigned char *basis);
+void crossover(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng);
+void crossover_two_point(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng);
+void crossover_uniform(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng);
+void mutation(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+void mutation_swap(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+void repair_alpha(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+int count_deletions(MCproblem *mcp, Individual *indv);
+void enforce_module_constraints(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+void set_rng_stream(MCproblem *mcp, pcg32_random_t *rng, unsigned int round, unsigned int index);
 int find_domination(MCproblem *mcp, Individual *indv_a, Individual *indv_b);
 void copy_individual(MCproblem *mcp, Individual *indv_source, Individual *indv_dest);
 void combine_populations(MCproblem *mcp, Population *pop1, Population *pop2, Population *combined_pop);
-void calculate_objective(MCproblem *mcp, Individual *indv, int k, int *change_bound);
+int calculate_objective(MCproblem *mcp, Individual *indv, int k, int *change_bound);
+int solve_objective(MCproblem *mcp, Individual *indv, int k, int *change_bound, glp_smcp *parm);
+void set_penalty_objectives(MCproblem *mcp, Individual *indv);
+uint64_t genome_hash(MCproblem *mcp, Individual *indv);
+uint64_t knockout_key(MCproblem *mcp, Individual *indv, int k, int *change_bound);
+int is_same_genome(MCproblem *mcp, Individual *indv_a, Individual *indv_b);
+void allocate_genome_set(GenomeSet *set, size_t max_size);
+void free_genome_set(GenomeSet *set);
+void clear_genome_set(GenomeSet *set);
+int insert_genome(MCproblem *mcp, GenomeSet *set, Individual *indv);
 
 /* moea.c */
 void run_moea(MCproblem *mcp, Population *initial_population);
+void selection_and_variation(MCproblem *mcp, Population *core_population, Population *offspring_population);
+
+/* moead.c */
+void run_moead(MCproblem *mcp, Population *parent_population);
+
+/* migration.c */
+void migration_init(MCproblem *mcp);
+void migration_free(MCproblem *mcp);
+void migration_initiate(MCproblem *mcp, Population *parent_population, int *receive_idx);
+int migration_sending(MCproblem *mcp);
+int migration_status(MCproblem *mcp);
+int migration_step(MCproblem *mcp, Population *parent_population, int *receive_idx, unsigned int n_generations, double begin);
+int migration_receive(MCproblem *mcp, Population *receive_population);
+void migration_complete(MCproblem *mcp, Population *parent_population, Population *receive_population, int *receive_idx);
+
+/* topology.c */
+void topology_init(MCproblem *mcp);
+void topology_free(void);
+int topology_fan_out(MCproblem *mcp);
+int topology_targets(MCproblem *mcp, Population *parent_population, int *targets);
+int topology_stall(void);
+void topology_observe(int source_pe, int stall);
+void topology_checkpoint(MCproblem *mcp, FILE *f, int restore);
+
+/* nsga3.c */
+size_t structured_reference_points(int n_obj, unsigned int max_points, double **points, int *divisions);
+void nsga3_init(MCproblem *mcp);
+void nsga3_free(void);
+void nsga3_select(MCproblem *mcp, Population *combined_pop, Population *parent_pop, item *head_fi, unsigned int fi_size, unsigned int *individuals_added);
+
+/* metrics.c */
+void metrics_init(MCproblem *mcp);
+void metrics_free(void);
+void metrics_record(MCproblem *mcp, Population *pop, unsigned int generation, double run_time, FrontMetrics *fm);
+size_t nondominated_objectives(MCproblem *mcp, Population *pop, double *front);
+double hypervolume(int n_obj, double *front, size_t n_points);
+
+/* convergence.c */
+void convergence_init(MCproblem *mcp);
+void convergence_check(MCproblem *mcp, FrontMetrics *fm, unsigned int generation);
+int convergence_poll(MCproblem *mcp);
+void convergence_finalize(MCproblem *mcp);
+
+/* archive.c */
+void archive_init(MCproblem *mcp);
+void archive_free(MCproblem *mcp);
+int archive_offer(MCproblem *mcp, Individual *indv);
+Population * archive_population(void);
+
+/* fitness_cache.c */
+void fitness_cache_init(MCproblem *mcp);
+void fitness_cache_free(MCproblem *mcp);
+int fitness_cache_lookup(MCproblem *mcp, Individual *indv, uint64_t *keys, int *hit);
+void fitness_cache_insert(MCproblem *mcp, uint64_t key, double objective);
+
+/* eval_store.c */
+void eval_store_init(MCproblem *mcp, const char *problem_dir_path);
+void eval_store_free(MCproblem *mcp);
+int eval_store_lookup(MCproblem *mcp, Individual *indv, uint64_t *keys, int *hit);
+void eval_store_insert(MCproblem *mcp, uint64_t key, double objective);
+void eval_store_add_individual(MCproblem *mcp, Individual *indv);
+
+/* schedule.c */
+void schedule_init(MCproblem *mcp);
+int schedule_due(MCproblem *mcp, unsigned int n_generations);
+void schedule_record(double seconds);
+void schedule_print(MCproblem *mcp);
+void schedule_checkpoint(FILE *f, int restore);
+
+/* checkpoint.c */
+void checkpoint_init(MCproblem *mcp);
+int checkpoint_poll(MCproblem *mcp, Population *parent_population, int *receive_idx, unsigned int n_generations, double run_time);
+void checkpoint_finalize(MCproblem *mcp, Population *parent_population, int *receive_idx, unsigned int n_generations, double run_time);
+void checkpoint_load(MCproblem *mcp, Population *parent_population, unsigned int *n_generations, double *run_time);
+void checkpoint_restore_state(MCproblem *mcp, Population *parent_population, int *receive_idx);
+void checkpoint_io(void *data, size_t size, FILE *f, int restore);
+
+/* global_archive.c */
+void global_archive_init(MCproblem *mcp);
+void global_archive_free(MCproblem *mcp);
+void global_archive_contribute(MCproblem *mcp, Population *pop);
+void global_archive_poll(MCproblem *mcp);
+void global_archive_finalize(MCproblem *mcp, Population *pop);
+void global_archive_print(MCproblem *mcp);
+
+/* local_search.c */
+void local_search_init(MCproblem *mcp);
+void local_search_free(MCproblem *mcp);
+unsigned int local_search(MCproblem *mcp, Population *pop);
+
+/* adaptive.c */
+void adaptive_init(MCproblem *mcp);
+void adaptive_variation(MCproblem *mcp, Individual *parent1, Individual *parent2, Individual *child1, Individual *child2, pcg32_random_t *rng);
+void adaptive_update(MCproblem *mcp, Population *offspring_pop, Population *parent_pop);
+void adaptive_print(MCproblem *mcp);
+void adaptive_checkpoint(FILE *f, int restore);
+
+/* gene_model.c */
+void gene_model_init(MCproblem *mcp);
+void gene_model_free(void);
+void gene_model_update(MCproblem *mcp, Population *pop, size_t n_indv, int front_only);
+void gene_model_mutation(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+void set_gene_model_individual(MCproblem *mcp, Individual *indv, pcg32_random_t *rng);
+int gene_model_site(MCproblem *mcp, pcg32_random_t *rng);
+
+/* screening.c */
+void screening_init(MCproblem *mcp);
+void screening_free(void);
+void screen_population(MCproblem *mcp, Population *parent_pop, Population *offspring_pop);
+void screening_complete(MCproblem *mcp, Population *parent_pop);
+void screening_print(MCproblem *mcp);
+
+/* surrogate.c */
+void surrogate_init(MCproblem *mcp);
+void surrogate_free(MCproblem *mcp);
+void surrogate_variation(MCproblem *mcp, Population *parent_pop, Population *offspring_pop);
+void surrogate_train(MCproblem *mcp, Population *parent_pop, Population *pop);
+void surrogate_print(MCproblem *mcp);
+
+/* kernels.c */
+void kernels_init(MCproblem *mcp);
+
+/* seeding.c */
+void seeding_init(MCproblem *mcp);
+void seeding_free(MCproblem *mcp);
+void set_seeded_population(MCproblem *mcp, Population *pop);
+void remove_blacklisted(MCproblem *mcp, Individual *indv);
+
+/* enumerate.c */
+void run_enumeration(MCproblem *mcp, char *out_population_path);
+
+/* modcell.c */
+void write_population(MCproblem *mcp, Population *pop, char *out_population_path);
 
 /* module_minimizer.c */
 void minimize_mr(MCproblem *mcp, Population *parent_population);
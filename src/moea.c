@@ -1,7 +1,6 @@
 /* Core MOEA (NSGA-II) method, relays heavily on the methods defined in functions.c */
 
 #include <stdlib.h>
-#include <time.h>
 #include "utlist.h"
 #include "modcell.h"
 
@@ -9,18 +8,13 @@ void run_moea(MCproblem *mcp, Population *parent_population);
 void selection_and_variation(MCproblem *mcp, Population *core_population, Population *offspring_population);
 void evaluate_population(MCproblem *mcp, Population *population);
 void environmental_selection(MCproblem *mcp, Population *parent_population, Population *offspring_population, Population *combined_population);
-Individual * tournament_k2(MCproblem *mcp, Individual *indv1, Individual *indv2);
+Individual * tournament_k2(MCproblem *mcp, Individual *indv1, Individual *indv2, pcg32_random_t *rng);
 void add_individuals(MCproblem *mcp, Population *combined_pop, Population *parent_pop, item *head_fi, unsigned int fi_size, unsigned int *individuals_added);
 void set_inf_crowding(MCproblem *mcp, Population *population);
 void assign_crowding_distance(MCproblem *mcp, Population *pop, item *head_fi, unsigned int fi_size);
 
 extern int mpi_pe, mpi_comm_size;
 
-void migration_initiate(MCproblem *mcp, Population *parent_population, Population *send_population, Population *receive_population, int *send_idx, int *receive_idx);
-int migration_status(MCproblem *mcp);
-void migration_complete(MCproblem *mcp, Population *parent_population, Population *receive_population, int *receive_idx);
-void migration_cancel(MCproblem *mcp);
-
 /* Macros */
 #define FREE_LIST(list_head) \
     DL_FOREACH_SAFE(list_head,elt,tmp) { \
@@ -29,10 +23,12 @@ void migration_cancel(MCproblem *mcp);
     };
 
 /* Globals */
-#define N_CORE_CALLS 8 /* Number of MPI messages (send and receive)*/
-#define N_MODULE_CALLS 2
-MPI_Request requests[N_CORE_CALLS], requests_m[N_MODULE_CALLS];
-MPI_Status statuses[N_CORE_CALLS], statuses_m[N_MODULE_CALLS];
+#define MAX_DUPLICATE_RETRIES 10 /* Re-mutation attempts for a duplicated offspring */
+GenomeSet genome_set;
+unsigned int n_duplicates = 0; /* Re-mutated offspring since last print */
+unsigned int n_local_improvements = 0; /* Moves accepted by local search since last print */
+unsigned int variation_round = INIT_RNG_ROUND; /* Calls to selection_and_variation(), identifies their RNG streams */
+pcg32_random_t *pair_rngs; /* [population_size/2] */
 
 /*Function definitions */
 
@@ -48,11 +44,8 @@ run_moea(MCproblem *mcp, Population *parent_population)
     allocate_population(mcp, offspring_population, mcp->population_size);
     allocate_population(mcp, combined_population, 2*mcp->population_size);
 
-    Population *send_population = malloc(sizeof(Population));
     Population *receive_population = malloc(sizeof(Population));
-    allocate_population(mcp, send_population, mcp->migration_size);
     allocate_population(mcp, receive_population, mcp->migration_size);
-    int *send_idx = malloc(mcp->migration_size * sizeof(int));
     int *receive_idx = malloc(mcp->migration_size * sizeof(int));
 
     unsigned int n_generations = 0;
@@ -61,49 +54,143 @@ run_moea(MCproblem *mcp, Population *parent_population)
     /* Avoid uninitialized individuals  */
     set_blank_population(mcp, offspring_population);
     set_blank_population(mcp, combined_population);
-    set_blank_population(mcp, send_population);
     set_blank_population(mcp, receive_population);
 
-    clock_t begin = clock();
-    evaluate_population(mcp, parent_population);
-    n_generations++;
-
-    set_inf_crowding(mcp, parent_population);
+    double begin = MPI_Wtime();
+    if (mcp->checkpoint_resume) { /* Evaluated population, ranks and crowding distances of the checkpoint */
+        checkpoint_load(mcp, parent_population, &n_generations, &run_time);
+        begin -= run_time;
+    }
+    else {
+        evaluate_population(mcp, parent_population);
+        n_generations++;
+        set_inf_crowding(mcp, parent_population);
+    }
     set_inf_crowding(mcp, offspring_population);
 
+    if (mcp->selection_engine == SELECTION_ENGINE_NSGA3)
+        nsga3_init(mcp);
+    if (mpi_comm_size > 1) {
+        migration_init(mcp);
+        schedule_init(mcp);
+    }
+    if (mcp->global_archive_interval > 0)
+        global_archive_init(mcp);
+    if (mcp->remove_duplicates)
+        allocate_genome_set(&genome_set, 2*mcp->population_size);
+    SAFE_ALLOC(pair_rngs = malloc(mcp->population_size/2 * sizeof *pair_rngs))
+
+    FrontMetrics fm;
+    int use_metrics = (mcp->metrics_path[0] != '\0') || (mcp->stall_generations > 0);
+    if (use_metrics)
+        metrics_init(mcp);
+    if (mcp->stall_generations > 0)
+        convergence_init(mcp);
+    if (mcp->archive_path[0] != '\0') {
+        archive_init(mcp);
+        for (int i=0; i < mcp->population_size; i++)
+            archive_offer(mcp, &(parent_population->indv[i]));
+    }
+    if (mcp->local_search_interval > 0)
+        local_search_init(mcp);
+    if (mcp->adaptive_operators)
+        adaptive_init(mcp);
+    if (mcp->screening_it_lim > 0)
+        screening_init(mcp);
+    if (mcp->surrogate_factor > 1) {
+        surrogate_init(mcp);
+        surrogate_train(mcp, NULL, parent_population);
+    }
+    if (mcp->checkpoint_resume)
+        checkpoint_restore_state(mcp, parent_population, receive_idx);
+    if (mcp->checkpoint_interval > 0)
+        checkpoint_init(mcp);
+
     int done = 0;
-    int active_migration = 0;
     while(!done) {
 
         /* Core procedure */
-        selection_and_variation(mcp, parent_population, offspring_population);
-        evaluate_population(mcp, offspring_population);
+        if (mcp->surrogate_factor > 1)
+            surrogate_variation(mcp, parent_population, offspring_population);
+        else
+            selection_and_variation(mcp, parent_population, offspring_population);
+        if (mcp->screening_it_lim > 0)
+            screen_population(mcp, parent_population, offspring_population);
+        else
+            evaluate_population(mcp, offspring_population);
+        if (mcp->surrogate_factor > 1)
+            surrogate_train(mcp, parent_population, offspring_population);
+        if (mcp->archive_path[0] != '\0')
+            for (int i=0; i < mcp->population_size; i++)
+                if (offspring_population->indv[i].objectives[0] != UNKNOWN_OBJ) /* Rejected by screening */
+                    archive_offer(mcp, &(offspring_population->indv[i]));
         environmental_selection(mcp, parent_population, offspring_population, combined_population);
+        if (mcp->screening_it_lim > 0)
+            screening_complete(mcp, parent_population);
+        if (mcp->adaptive_operators)
+            adaptive_update(mcp, offspring_population, parent_population);
+        if (mcp->guided_mutation)
+            gene_model_update(mcp, parent_population, parent_population->size, 1);
+        if ((mcp->local_search_interval > 0) && (n_generations % mcp->local_search_interval == 0))
+            n_local_improvements += local_search(mcp, parent_population);
 
         /* Migration */
-        if (mpi_comm_size > 1) {
-            if (active_migration) {
-                if (migration_status(mcp)) {
-                    migration_complete(mcp, parent_population, receive_population, receive_idx);
-                    active_migration = 0;
-                    if (mcp->verbose) printf("...PE: %i end migration: %.0fs ...\n", mpi_pe, (double)(clock() - begin) / CLOCKS_PER_SEC);
-                }
-            }
-            else if ( n_generations % mcp->migration_interval == 0)  {
-                migration_initiate(mcp, parent_population, send_population, receive_population, send_idx, receive_idx);
-                active_migration = 1;
-                if (mcp->verbose) printf("PE: %i Begin migration: %.0fs ...\n", mpi_pe, (double)(clock() - begin) / CLOCKS_PER_SEC);
-            }
+        if ((mpi_comm_size > 1) && migration_step(mcp, parent_population, receive_idx, n_generations, begin))
+            migration_complete(mcp, parent_population, receive_population, receive_idx);
+        if (mcp->global_archive_interval > 0) {
+            if (n_generations % mcp->global_archive_interval == 0)
+                global_archive_contribute(mcp, parent_population);
+            global_archive_poll(mcp);
         }
 
         /* Local book keeping */
         n_generations++;
 
-        run_time = (double)(clock() - begin) / CLOCKS_PER_SEC;
+        run_time = MPI_Wtime() - begin;
 
         if (mcp->verbose && ( (n_generations-1) % PRINT_INTERVAL == 0))
             printf("PE: %i\t Generation:%i\t Time:%.1fs\n", mpi_pe, n_generations-1, run_time);
 
+        if (mcp->remove_duplicates && ( (n_generations-1) % PRINT_INTERVAL == 0)) {
+            if (mcp->verbose) printf("PE: %i\t Re-mutated duplicates:%u\n", mpi_pe, n_duplicates);
+            n_duplicates = 0;
+        }
+
+        if ((mcp->local_search_interval > 0) && ( (n_generations-1) % PRINT_INTERVAL == 0)) {
+            if (mcp->verbose) printf("PE: %i\t Local search improvements:%u\n", mpi_pe, n_local_improvements);
+            n_local_improvements = 0;
+        }
+
+        if ((mcp->screening_it_lim > 0) && mcp->verbose && ( (n_generations-1) % PRINT_INTERVAL == 0))
+            screening_print(mcp);
+
+        if ((mcp->surrogate_factor > 1) && mcp->verbose && ( (n_generations-1) % PRINT_INTERVAL == 0))
+            surrogate_print(mcp);
+
+        if (mcp->adaptive_operators && mcp->verbose && ( (n_generations-1) % PRINT_INTERVAL == 0))
+            adaptive_print(mcp);
+
+        if ((mcp->global_archive_interval > 0) && mcp->verbose && ( (n_generations-1) % PRINT_INTERVAL == 0))
+            global_archive_print(mcp);
+
+        if ((mpi_comm_size > 1) && mcp->verbose && ( (n_generations-1) % PRINT_INTERVAL == 0))
+            schedule_print(mcp);
+
+        if (use_metrics && ( (n_generations-1) % PRINT_INTERVAL == 0)) {
+            metrics_record(mcp, parent_population, n_generations-1, run_time, &fm);
+            if (mcp->stall_generations > 0)
+                convergence_check(mcp, &fm, n_generations-1);
+        }
+        if ((mcp->stall_generations > 0) && convergence_poll(mcp)) {
+            done = 1;
+            if (mcp->verbose) printf("PE: %i\t All islands stalled \t Time:%.1fs\n", mpi_pe, run_time);
+        }
+
+        if ((mcp->checkpoint_interval > 0) && checkpoint_poll(mcp, parent_population, receive_idx, n_generations, run_time)) {
+            done = 1;
+            if (mcp->verbose) printf("PE: %i\t Stopped by signal \t Time:%.1fs\n", mpi_pe, run_time);
+        }
+
         if (run_time > mcp->max_run_time) {
             done = 1;
             if (mcp->verbose) printf("PE: %i\t Run time limit reached \t Time:%.1fs\n", mpi_pe, run_time);
@@ -114,168 +201,136 @@ run_moea(MCproblem *mcp, Population *parent_population)
         }
     }
 
+    if (mcp->global_archive_interval > 0) /* Before any blocking collective */
+        global_archive_finalize(mcp, parent_population);
+    if (mcp->stall_generations > 0)
+        convergence_finalize(mcp);
+    if (mcp->checkpoint_interval > 0)
+        checkpoint_finalize(mcp, parent_population, receive_idx, n_generations, run_time);
+
     /* Avoid errors that seem to occur when PEs desync*/
     MPI_Barrier(MPI_COMM_WORLD);
     if (mpi_pe == 0) printf("Barrier reached, writting populations...\n");
 
+    if (use_metrics)
+        metrics_free();
+    if (mcp->archive_path[0] != '\0') {
+        write_population(mcp, archive_population(), mcp->archive_path);
+        archive_free(mcp);
+    }
+
     /* Do not attempt since this can lead to errors in MPI_Cancel (maybe one of the PEs involved is finished?) Also seems to fail if a PE is far ahead of others
-    if (active_migration)
+    if (migration_sending(mcp))
         migration_cancel(mcp);
     */
 
+    if (mcp->selection_engine == SELECTION_ENGINE_NSGA3)
+        nsga3_free();
+    if (mcp->remove_duplicates)
+        free_genome_set(&genome_set);
+    free(pair_rngs);
+    if (mcp->local_search_interval > 0)
+        local_search_free(mcp);
+    if (mcp->screening_it_lim > 0)
+        screening_free();
+    if (mcp->surrogate_factor > 1)
+        surrogate_free(mcp);
+
     free_population(mcp, offspring_population);
     free_population(mcp, combined_population);
-    free_population(mcp, send_population);
     free_population(mcp, receive_population);
-    free(send_idx);
     free(receive_idx);
+    if (mpi_comm_size > 1)
+        migration_free(mcp);
+    if (mcp->global_archive_interval > 0)
+        global_archive_free(mcp);
 }
 
 
 
-/* Sends and receives individuals from other islands (PEs)
- * Notes:
- *      - Migration policies other than random depend on how parent_population is sorted.
- *      - MPI is not good at sending structures with arrays but only with basic types. Thus each field is passed independently.
- *      - The current form of async migration does not differentiate between sending and receiving data. An even more decoupled approach could separate these two aspects. Although this might not necessary be good for the heuristics. However, for certain topologies if an island is particularly slow it can lock several other migrations.
- */
-void
-migration_initiate(MCproblem *mcp, Population *parent_population, Population *send_population, Population *receive_population, int *send_idx, int *receive_idx)
-{
-    int target_pe;
-    int i, tag = 10;
-    Individual *send_indv, *recv_indv;
-
-    /* Message passing topology */ // If it is not dynamic it can be determined outside of this method
-    if (mcp->migration_topology == MIGRATION_TOPOLOGY_RING) {
-        if (mpi_pe == mpi_comm_size - 1)
-            target_pe = 0;
-        else
-            target_pe = mpi_pe + 1;
-    }
-    else if (mcp->migration_topology == MIGRATION_TOPOLOGY_RANDOM) {
-        do {
-            target_pe = (int)pcg32_boundedrand(mpi_comm_size);
-        } while (target_pe != mpi_pe);
-    } else { fprintf (stderr, "error: Invalid migration topology option"); exit(-1); }
-
-    /* Determine individuals to send and receive */
-    if (mcp->migration_policy == MIGRATION_POLICY_REPLACE_SENT) {
-        for (i=0; i < mcp->migration_size; i++) {
-            send_idx[i] = i;
-            receive_idx[i] = i;
-        }
-    }
-    else if (mcp->migration_policy == MIGRATION_POLICY_REPLACE_BOTTOM) {
-        for (i=0; i < mcp->migration_size; i++) {
-            send_idx[i] = i;
-            receive_idx[i] = mcp->population_size - 1 - i;
-        }
-    }
-    else if (mcp->migration_policy == MIGRATION_POLICY_RANDOM) {
-        for (i=0; i < mcp->migration_size; i++) {
-            send_idx[i] = i; (int)pcg32_boundedrand(mcp->population_size);
-            receive_idx[i] = send_idx[i];
-        }
-    } else { fprintf (stderr, "error: Invalid migration policy option"); exit(-1); }
-
-
-    /* Message exchange */
-    for (i=0; i < mcp->migration_size; i++) {
-
-        copy_individual(mcp,  &(parent_population->indv[send_idx[i]]), &(send_population->indv[i]));
-        send_indv = &(send_population->indv[i]);
-        recv_indv = &(receive_population->indv[i]);
-
-        /* Deletions */
-        MPI_Isend(send_indv->deletions, mcp->n_vars, MPI_INT, target_pe, tag, MPI_COMM_WORLD, &requests[0] );
-        MPI_Irecv(recv_indv->deletions, mcp->n_vars, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &requests[1]);
-        /* Objectives */
-        MPI_Isend(send_indv->objectives, mcp->n_models, MPI_DOUBLE, target_pe, tag, MPI_COMM_WORLD, &requests[2]);
-        MPI_Irecv(recv_indv->objectives, mcp->n_models, MPI_DOUBLE, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &requests[3]);
-        /* Penalty_Objectives */
-        MPI_Isend(send_indv->penalty_objectives, mcp->n_models, MPI_DOUBLE, target_pe, tag, MPI_COMM_WORLD, &requests[4]);
-        MPI_Irecv(recv_indv->penalty_objectives, mcp->n_models, MPI_DOUBLE, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &requests[5]);
-        /* Crowding distance */
-        MPI_Isend(&(send_indv->crowding_distance), 1, MPI_DOUBLE, target_pe, tag, MPI_COMM_WORLD, &requests[6]);
-        MPI_Irecv(&(recv_indv->crowding_distance), 1, MPI_DOUBLE, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &requests[7]);
-        /* Module reactions */
-        if (mcp->use_modules) {
-            MPI_Isend(send_indv->modules, mcp->n_models * mcp->n_vars, MPI_INT, target_pe, tag, MPI_COMM_WORLD, &requests_m[0]);
-            MPI_Irecv(recv_indv->modules, mcp->n_models * mcp->n_vars, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &requests_m[1]);
-        }
-    }
-}
-
-int
-migration_status(MCproblem *mcp)
-{
-    int flag = 0;
-    int flag_m = !mcp->use_modules; /* If using modules set it to false for it to be proven true, otherwise always true */
-    MPI_Testall(N_CORE_CALLS, requests, &flag, statuses);
-    if (mcp->use_modules)
-        MPI_Testall(N_MODULE_CALLS, requests_m, &flag_m, statuses_m);
-    return flag && flag_m;
-}
-
-void
-migration_complete(MCproblem *mcp, Population *parent_population, Population *receive_population, int *receive_idx)
-{
-        for (int i=0; i < mcp->migration_size; i++)
-            copy_individual(mcp,  &(receive_population->indv[i]), &(parent_population->indv[receive_idx[i]]));
-}
-
-void
-migration_cancel(MCproblem *mcp)
-{
-    int i;
-    for (i=0; i < N_CORE_CALLS; i++)
-        MPI_Cancel(&requests[i]);
-    if (mcp->use_modules)
-        for (i=0; i < N_MODULE_CALLS; i++)
-            MPI_Cancel(&requests_m[i]);
-}
-
-
 /* Creates offspring population by tournament selection, crossover, and mutation.
  * Notes:
  *      - TODO: Candidate parents for tournament selection are selected purely at random. It might be valuable to consider a scheme where such candidates cannot repeat themselves, which might lead to better diversity.
  *      - The new individuals will have some uninitialized fields.
+ *      - If duplicates are removed, offspring identical to a parent or to a previous offspring get a random bit flipped (up to MAX_DUPLICATE_RETRIES times) so no evaluations are spent on known genomes.
  */
 void
 selection_and_variation(MCproblem *mcp, Population *parent_population, Population *offspring_population)
 {
-    int i;
+    int i, retry, site;
+    Individual *indv;
     Individual *parent1, *parent2;
+    pcg32_random_t *rng;
 
-    /*Tournament selection and crossover*/
+    variation_round++;
+
+    /* Each pair of offspring only draws from its own RNG stream, so it does not depend on the order in which pairs are created */
     for (i=0; i < mcp->population_size; i+=2) {
-        parent1 = tournament_k2(mcp, &(parent_population->indv[(int)pcg32_boundedrand(mcp->population_size)]), &(parent_population->indv[(int)pcg32_boundedrand(mcp->population_size)]));
-        parent2 = tournament_k2(mcp, &(parent_population->indv[(int)pcg32_boundedrand(mcp->population_size)]), &(parent_population->indv[(int)pcg32_boundedrand(mcp->population_size)]));
-        crossover(mcp, parent1, parent2, &(offspring_population->indv[i]), &(offspring_population->indv[i+1]));
+        rng = &(pair_rngs[i/2]);
+        set_rng_stream(mcp, rng, variation_round, i/2);
+
+        /*Tournament selection and crossover*/
+        parent1 = tournament_k2(mcp, &(parent_population->indv[(int)pcg32_boundedrand_r(rng, mcp->population_size)]), &(parent_population->indv[(int)pcg32_boundedrand_r(rng, mcp->population_size)]), rng);
+        parent2 = tournament_k2(mcp, &(parent_population->indv[(int)pcg32_boundedrand_r(rng, mcp->population_size)]), &(parent_population->indv[(int)pcg32_boundedrand_r(rng, mcp->population_size)]), rng);
+        if (mcp->adaptive_operators)
+            adaptive_variation(mcp, parent1, parent2, &(offspring_population->indv[i]), &(offspring_population->indv[i+1]), rng);
+        else
+            crossover(mcp, parent1, parent2, &(offspring_population->indv[i]), &(offspring_population->indv[i+1]), rng);
+
+        for (int c=i; c < i+2; c++) {
+            indv = &(offspring_population->indv[c]);
+
+            /* Mutation (done by adaptive_variation() if operators are adaptive) */
+            if (mcp->guided_mutation && !mcp->adaptive_operators)
+                gene_model_mutation(mcp, indv, rng);
+            else if (!mcp->adaptive_operators)
+                mutation(mcp, indv, rng);
+
+            /* Constraint enforcement */
+            if (mcp->blacklist != NULL)
+                remove_blacklisted(mcp, indv);
+            if (mcp->alpha_repair)
+                repair_alpha(mcp, indv, rng);
+            if (mcp->use_modules)
+                enforce_module_constraints(mcp, indv, rng);
+        }
     }
 
-    /* Mutation */
-    for (i=0; i < mcp->population_size; i++)
-        mutation(mcp, &(offspring_population->indv[i]));
-
-    /* Constraint enforcement */
-    if (mcp->use_modules)
+    /* Duplicate elimination */
+    if (mcp->remove_duplicates) {
+        clear_genome_set(&genome_set);
         for (i=0; i < mcp->population_size; i++)
-            enforce_module_constraints(mcp, &(offspring_population->indv[i]));
+            insert_genome(mcp, &genome_set, &(parent_population->indv[i]));
+        for (i=0; i < mcp->population_size; i++) {
+            indv = &(offspring_population->indv[i]);
+            rng = &(pair_rngs[i/2]); /* Continues the stream of the pair */
+            for (retry=0; (retry < MAX_DUPLICATE_RETRIES) && !insert_genome(mcp, &genome_set, indv); retry++) {
+                if (mcp->alpha_repair) {
+                    mutation_swap(mcp, indv, rng);
+                } else {
+                    site = pcg32_boundedrand_r(rng, mcp->n_vars);
+                    indv->deletions[site] = !indv->deletions[site];
+                }
+                if (mcp->use_modules)
+                    enforce_module_constraints(mcp, indv, rng);
+                n_duplicates++;
+            }
+        }
+    }
 }
 
 
-/* Tournament selection between two individuals for NSGA-II */
+/* Tournament selection between two individuals for NSGA-II (NSGA-III does not use crowding distance, so ties are broken at random) */
 Individual *
-tournament_k2(MCproblem *mcp, Individual *indv1, Individual *indv2)
+tournament_k2(MCproblem *mcp, Individual *indv1, Individual *indv2, pcg32_random_t *rng)
 {
     int f = find_domination(mcp, indv1, indv2);
     if (f == A_DOMINATES_B)  return (indv1);
     if (f == B_DOMINATES_A) return(indv2);
+    if (mcp->selection_engine == SELECTION_ENGINE_NSGA3) return (pcg32_boundedrand_r(rng, 2) ? indv1 : indv2);
     if (indv1->crowding_distance > indv2->crowding_distance) return(indv1);
     if (indv2->crowding_distance > indv1->crowding_distance) return(indv2);
-    return (pcg32_boundedrand(2) ? indv1 : indv2);
+    return (pcg32_boundedrand_r(rng, 2) ? indv1 : indv2);
 }
 
 /* Assign objective values to each individual */
@@ -289,6 +344,7 @@ evaluate_population(MCproblem *mcp, Population *population)
 /* Selects most fit individuals from both parents and offspring populations to create a new parent_population
  * Notes:
  *      - Do non-dominated sorting of each front, calculate distances (if needed, i.e., front size is greater than individuals left to fill pop), then stop when pop is filled
+ *      - If duplicates are removed, only the first copy of each genome takes part in the sorting and the rest are used last, only if there are not enough unique individuals.
  */
 void
 environmental_selection(MCproblem *mcp, Population *parent_pop, Population *offspring_pop, Population *combined_pop)
@@ -297,13 +353,25 @@ environmental_selection(MCproblem *mcp, Population *parent_pop, Population *offs
 
     int i, it1, it2, domflag, is_fi_empty;
     int *domination_count = calloc(combined_pop->size, sizeof(int)); /* keeps domination count (np, nq) of each individual */
+    int *is_duplicate = NULL;
     Individual *p, *q;
     item *head_sp = NULL, *head_fi = NULL, *head_f_next=NULL, *node, *tmp, *elt, *ref, *elt_p, *elt_q;
     unsigned int individuals_added = 0, fi_size = 0;
 
+    if (mcp->remove_duplicates) {
+        is_duplicate = calloc(combined_pop->size, sizeof(int));
+        clear_genome_set(&genome_set);
+        for (it1=0; it1 < combined_pop->size; it1++)
+            is_duplicate[it1] = !insert_genome(mcp, &genome_set, &(combined_pop->indv[it1]));
+    }
+
     for (it1=0; it1 < combined_pop->size; it1++) {
+        if (is_duplicate && is_duplicate[it1])
+            continue;
+        p = &(combined_pop->indv[it1]);
         for (it2=0; it2 < combined_pop->size; it2++) {
-            p = &(combined_pop->indv[it1]);
+            if (is_duplicate && is_duplicate[it2])
+                continue;
             q = &(combined_pop->indv[it2]);
 
             domflag = find_domination(mcp, p, q);
@@ -365,8 +433,15 @@ environmental_selection(MCproblem *mcp, Population *parent_pop, Population *offs
             goto cleanup;
     }
 
+    /* Not enough unique individuals */
+    if (is_duplicate)
+        for (it1=0; (it1 < combined_pop->size) && (individuals_added < parent_pop->size); it1++)
+            if (is_duplicate[it1])
+                copy_individual(mcp, &(combined_pop->indv[it1]), &(parent_pop->indv[individuals_added++]));
+
     /* Free memory */
 cleanup:   free(domination_count);
+    free(is_duplicate);
     FREE_LIST(head_sp);
     FREE_LIST(head_fi);
     FREE_LIST(head_f_next);
@@ -407,7 +482,7 @@ sortcrowding(item *a, item *b)
  *      - last_index is the index of the last individual in new_pop.
  * Notes:
  *      - Sorting a list pointer within a function causes errors when trying to free that list. The solution is to work with local copies (or to use a library other than UTLIST). That is also why this function has the crowding_distance calculation embedded instead of in a smaller function
- *      - Alternative metrics can be used instead of crowding distance, such as reference point distance.
+ *      - With SELECTION_ENGINE_NSGA3 the last front is truncated by reference point niching (nsga3.c) instead of crowding distance.
  */
 
 void
@@ -428,6 +503,12 @@ add_individuals(MCproblem *mcp, Population *combined_pop, Population *parent_pop
 
     /* If fi size is above what is needed to fill the pop calculate crowding distance and sort fi by it*/
 
+    if ((fi_size > (parent_pop->size - *individuals_added)) && (mcp->selection_engine == SELECTION_ENGINE_NSGA3)) {
+        nsga3_select(mcp, combined_pop, parent_pop, head_fi, fi_size, individuals_added);
+        FREE_LIST(head_fi);
+        return;
+    }
+
     if (fi_size > (parent_pop->size - *individuals_added)) {
         item  *elt, *tail_fi;
         int it;
@@ -0,0 +1,334 @@
+/* MOEA/D (Zhang and Li, 2007) engine, alternative to run_moea(). Each individual of the population is the incumbent of a weighted Tchebycheff subproblem, so no global non-dominated sorting is needed.
+ * Notes:
+ *      - Neighbouring subproblems have similar incumbents, thus each subproblem keeps the GLPK basis of its incumbent for every model and its children are warm-started from it. When a child replaces a neighbour incumbent its basis is copied along.
+ *      - Migrants are offered to every subproblem and replace incumbents they improve, so islands running MOEA/D and NSGA-II can exchange individuals.
+ *      - Guided mutation samples from the frequencies of all the incumbents, as they are not ranked.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "modcell.h"
+
+#define MOEAD_NEIGHBOURHOOD_SIZE 20 	/* Number of closest weight vectors that define the neighbourhood of a subproblem */
+#define MOEAD_DELTA 0.9 		/* Probability of selecting mates (and replacement candidates) from the neighbourhood instead of the whole population */
+#define MOEAD_NR 2 			/* Maximum number of incumbents replaced by a single child */
+#define WEIGHT_FLOOR 1.0e-6 		/* Avoids zero weights in the Tchebycheff function */
+
+void run_moead(MCproblem *mcp, Population *parent_population);
+static void set_weights(MCproblem *mcp);
+static void set_neighbours(MCproblem *mcp);
+static double tchebycheff(MCproblem *mcp, Individual *indv, int sp);
+static void update_ideal(MCproblem *mcp, Individual *indv);
+static int update_subproblems(MCproblem *mcp, Population *pop, Individual *child, unsigned char *child_basis, int *pool, int pool_size);
+static void shuffle(int *array, int n);
+
+extern int mpi_pe, mpi_comm_size;
+
+/* Globals */
+static double *weights; 	/* [population_size*n_models] */
+static int *neighbours; 	/* [population_size*n_neighbours] */
+static int n_neighbours;
+static unsigned char *bases; 	/* [population_size*basis_size] Basis of each subproblem incumbent */
+static double *ideal; 		/* [n_models] Best value found for each objective */
+
+/* Main loop of MOEA/D, population size, termination criteria and migration parameters are the same as in run_moea() */
+void
+run_moead(MCproblem *mcp, Population *parent_population)
+{
+    int i, j, sp, pool_size, n_pop = mcp->population_size;
+    int *order, *all, *pool;
+    Individual *child;
+    unsigned char *child_basis;
+    pcg32_random_t rng; /* Stream of the current subproblem and generation */
+
+    Population *offspring = malloc(sizeof(Population));
+    allocate_population(mcp, offspring, 2);
+    set_blank_population(mcp, offspring);
+
+    Population *receive_population = malloc(sizeof(Population));
+    allocate_population(mcp, receive_population, mcp->migration_size);
+    set_blank_population(mcp, receive_population);
+    int *receive_idx = malloc(mcp->migration_size * sizeof(int));
+
+    SAFE_ALLOC(weights = malloc(n_pop * mcp->n_models * sizeof *weights))
+    SAFE_ALLOC(ideal = malloc(mcp->n_models * sizeof *ideal))
+    SAFE_ALLOC(bases = malloc(n_pop * mcp->basis_size * sizeof *bases))
+    SAFE_ALLOC(child_basis = malloc(mcp->basis_size * sizeof *child_basis))
+    SAFE_ALLOC(order = malloc(n_pop * sizeof *order))
+    SAFE_ALLOC(all = malloc(n_pop * sizeof *all))
+    SAFE_ALLOC(pool = malloc(n_pop * sizeof *pool))
+
+    set_weights(mcp);
+    if (mpi_comm_size > 1) {
+        migration_init(mcp);
+        schedule_init(mcp);
+    }
+    if (mcp->global_archive_interval > 0)
+        global_archive_init(mcp);
+    set_neighbours(mcp);
+    for (i=0; i < n_pop; i++)
+        order[i] = all[i] = i;
+
+    unsigned int n_generations = 0;
+    double run_time = 0;
+    double begin = MPI_Wtime();
+
+    /* Initial incumbents and their bases */
+    for (j=0; j < mcp->n_models; j++)
+        ideal[j] = -INF;
+    for (i=0; i < n_pop; i++) {
+        calculate_objectives_basis(mcp, &(parent_population->indv[i]), NULL, &(bases[i*mcp->basis_size]));
+        update_ideal(mcp, &(parent_population->indv[i]));
+    }
+    n_generations++;
+
+    FrontMetrics fm;
+    int use_metrics = (mcp->metrics_path[0] != '\0') || (mcp->stall_generations > 0);
+    if (use_metrics)
+        metrics_init(mcp);
+    if (mcp->stall_generations > 0)
+        convergence_init(mcp);
+    if (mcp->archive_path[0] != '\0') {
+        archive_init(mcp);
+        for (int i=0; i < mcp->population_size; i++)
+            archive_offer(mcp, &(parent_population->indv[i]));
+    }
+
+    int done = 0;
+    int n_migrants;
+    while(!done) {
+
+        /* Core procedure */
+        shuffle(order, n_pop);
+        for (i=0; i < n_pop; i++) {
+            sp = order[i];
+            set_rng_stream(mcp, &rng, n_generations, sp);
+            if ( (double)pcg32_boundedrand_r(&rng, 100)/100 < MOEAD_DELTA) {
+                pool_size = n_neighbours;
+                memcpy(pool, &(neighbours[sp*n_neighbours]), pool_size * sizeof *pool);
+            } else {
+                pool_size = n_pop;
+                memcpy(pool, all, pool_size * sizeof *pool);
+            }
+
+            crossover(mcp, &(parent_population->indv[pool[pcg32_boundedrand_r(&rng, pool_size)]]), &(parent_population->indv[pool[pcg32_boundedrand_r(&rng, pool_size)]]),
+                    &(offspring->indv[0]), &(offspring->indv[1]), &rng);
+            child = &(offspring->indv[0]);
+            if (mcp->guided_mutation)
+                gene_model_mutation(mcp, child, &rng);
+            else
+                mutation(mcp, child, &rng);
+            if (mcp->blacklist != NULL)
+                remove_blacklisted(mcp, child);
+            if (mcp->alpha_repair)
+                repair_alpha(mcp, child, &rng);
+            if (mcp->use_modules)
+                enforce_module_constraints(mcp, child, &rng);
+
+            calculate_objectives_basis(mcp, child, &(bases[sp*mcp->basis_size]), child_basis);
+            update_ideal(mcp, child);
+            if (mcp->archive_path[0] != '\0')
+                archive_offer(mcp, child);
+            update_subproblems(mcp, parent_population, child, child_basis, pool, pool_size);
+        }
+        if (mcp->guided_mutation)
+            gene_model_update(mcp, parent_population, parent_population->size, 0);
+
+        /* Migration, migrants are offered to all subproblems and keep the basis of the incumbent they replace */
+        if ((mpi_comm_size > 1) && migration_step(mcp, parent_population, receive_idx, n_generations, begin)) {
+            n_migrants = migration_receive(mcp, receive_population);
+            for (j=0; j < n_migrants; j++) {
+                update_ideal(mcp, &(receive_population->indv[j]));
+                memcpy(pool, all, n_pop * sizeof *pool);
+                update_subproblems(mcp, parent_population, &(receive_population->indv[j]), NULL, pool, n_pop);
+            }
+        }
+        if (mcp->global_archive_interval > 0) {
+            if (n_generations % mcp->global_archive_interval == 0)
+                global_archive_contribute(mcp, parent_population);
+            global_archive_poll(mcp);
+        }
+
+        /* Local book keeping */
+        n_generations++;
+
+        run_time = MPI_Wtime() - begin;
+
+        if (mcp->verbose && ( (n_generations-1) % PRINT_INTERVAL == 0))
+            printf("PE: %i\t Generation:%i\t Time:%.1fs\n", mpi_pe, n_generations-1, run_time);
+
+        if ((mcp->global_archive_interval > 0) && mcp->verbose && ( (n_generations-1) % PRINT_INTERVAL == 0))
+            global_archive_print(mcp);
+
+        if ((mpi_comm_size > 1) && mcp->verbose && ( (n_generations-1) % PRINT_INTERVAL == 0))
+            schedule_print(mcp);
+
+        if (use_metrics && ( (n_generations-1) % PRINT_INTERVAL == 0)) {
+            metrics_record(mcp, parent_population, n_generations-1, run_time, &fm);
+            if (mcp->stall_generations > 0)
+                convergence_check(mcp, &fm, n_generations-1);
+        }
+        if ((mcp->stall_generations > 0) && convergence_poll(mcp)) {
+            done = 1;
+            if (mcp->verbose) printf("PE: %i\t All islands stalled \t Time:%.1fs\n", mpi_pe, run_time);
+        }
+
+        if (run_time > mcp->max_run_time) {
+            done = 1;
+            if (mcp->verbose) printf("PE: %i\t Run time limit reached \t Time:%.1fs\n", mpi_pe, run_time);
+        }
+        if (n_generations > mcp->n_generations) {
+            done = 1;
+            if (mcp->verbose) printf("PE: %i\t Generation limit reached \t Time:%.1fs\n", mpi_pe, run_time);
+        }
+    }
+
+    if (mcp->global_archive_interval > 0) /* Before any blocking collective */
+        global_archive_finalize(mcp, parent_population);
+    if (mcp->stall_generations > 0)
+        convergence_finalize(mcp);
+
+    /* Avoid errors that seem to occur when PEs desync*/
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (mpi_pe == 0) printf("Barrier reached, writting populations...\n");
+
+    if (use_metrics)
+        metrics_free();
+    if (mcp->archive_path[0] != '\0') {
+        write_population(mcp, archive_population(), mcp->archive_path);
+        archive_free(mcp);
+    }
+
+    free_population(mcp, offspring);
+    free_population(mcp, receive_population);
+    free(receive_idx);
+    if (mpi_comm_size > 1)
+        migration_free(mcp);
+    if (mcp->global_archive_interval > 0)
+        global_archive_free(mcp);
+    free(weights);
+    free(neighbours);
+    free(ideal);
+    free(bases);
+    free(child_basis);
+    free(order);
+    free(all);
+    free(pool);
+}
+
+/* One weight vector per subproblem. Structured points are used first and the remainder is sampled uniformly from the simplex. */
+static void
+set_weights(MCproblem *mcp)
+{
+    int i, k, divisions[2], M = mcp->n_models;
+    double *points, sum;
+    size_t n_points = structured_reference_points(M, mcp->population_size, &points, divisions);
+
+    memcpy(weights, points, n_points * M * sizeof *weights);
+    free(points);
+
+    for (i=n_points; i < mcp->population_size; i++) {
+        sum = 0;
+        for (k=0; k < M; k++) {
+            weights[i*M + k] = -log(((double)pcg32_random() + 1.0) / 4294967297.0);
+            sum += weights[i*M + k];
+        }
+        for (k=0; k < M; k++)
+            weights[i*M + k] /= sum;
+    }
+
+    for (i=0; i < mcp->population_size*M; i++)
+        if (weights[i] < WEIGHT_FLOOR)
+            weights[i] = WEIGHT_FLOOR;
+}
+
+/* The neighbourhood of each subproblem are the closest weight vectors, including itself */
+static void
+set_neighbours(MCproblem *mcp)
+{
+    int i, j, k, l, M = mcp->n_models, n_pop = mcp->population_size;
+    double d, *dist;
+
+    n_neighbours = MOEAD_NEIGHBOURHOOD_SIZE < n_pop ? MOEAD_NEIGHBOURHOOD_SIZE : n_pop;
+    SAFE_ALLOC(neighbours = malloc(n_pop * n_neighbours * sizeof *neighbours))
+    SAFE_ALLOC(dist = malloc(n_neighbours * sizeof *dist))
+
+    for (i=0; i < n_pop; i++) {
+        /* Insertion into a sorted list of the closest n_neighbours */
+        int n_found = 0;
+        for (j=0; j < n_pop; j++) {
+            d = 0;
+            for (k=0; k < M; k++)
+                d += (weights[i*M + k] - weights[j*M + k]) * (weights[i*M + k] - weights[j*M + k]);
+            if ((n_found == n_neighbours) && (d >= dist[n_found-1]))
+                continue;
+            l = (n_found < n_neighbours) ? n_found++ : n_found - 1;
+            while ((l > 0) && (dist[l-1] > d)) {
+                dist[l] = dist[l-1];
+                neighbours[i*n_neighbours + l] = neighbours[i*n_neighbours + l-1];
+                l--;
+            }
+            dist[l] = d;
+            neighbours[i*n_neighbours + l] = j;
+        }
+    }
+    free(dist);
+}
+
+/* Weighted Tchebycheff distance to the ideal point for subproblem sp (lower is better, objectives are maximized) */
+static double
+tchebycheff(MCproblem *mcp, Individual *indv, int sp)
+{
+    double g = 0, v;
+    for (int k=0; k < mcp->n_models; k++) {
+        v = weights[sp*mcp->n_models + k] * (ideal[k] - indv->penalty_objectives[k]);
+        if (v > g)
+            g = v;
+    }
+    return g;
+}
+
+static void
+update_ideal(MCproblem *mcp, Individual *indv)
+{
+    for (int k=0; k < mcp->n_models; k++)
+        if (indv->penalty_objectives[k] > ideal[k])
+            ideal[k] = indv->penalty_objectives[k];
+}
+
+/* Replaces at most MOEAD_NR incumbents in pool (visited in random order) that are improved by child. Returns number of replacements.
+ *      - child_basis: basis copied along with the child, if NULL the replaced incumbent basis is kept.
+ *      - pool is shuffled in place.
+ */
+static int
+update_subproblems(MCproblem *mcp, Population *pop, Individual *child, unsigned char *child_basis, int *pool, int pool_size)
+{
+    int i, sp, n_replaced = 0;
+
+    shuffle(pool, pool_size);
+    for (i=0; i < pool_size; i++) {
+        sp = pool[i];
+        if (tchebycheff(mcp, child, sp) < tchebycheff(mcp, &(pop->indv[sp]), sp)) {
+            copy_individual(mcp, child, &(pop->indv[sp]));
+            if (child_basis)
+                memcpy(&(bases[sp*mcp->basis_size]), child_basis, mcp->basis_size * sizeof *bases);
+            if (++n_replaced == MOEAD_NR)
+                break;
+        }
+    }
+    return n_replaced;
+}
+
+/* Fisher-Yates shuffle */
+static void
+shuffle(int *array, int n)
+{
+    int i, j, tmp;
+    for (i=n-1; i > 0; i--) {
+        j = pcg32_boundedrand(i+1);
+        tmp = array[i];
+        array[i] = array[j];
+        array[j] = tmp;
+    }
+}
@@ -0,0 +1,326 @@
+/* NSGA-III selection engine (Deb and Jain, 2014). Replaces crowding distance truncation of the last front when many production networks are used, since then almost every individual is non-dominated and crowding distance no longer guides selection.
+ * Notes:
+ *      - Design objectives are maximized, internally they are translated with respect to the ideal point so the usual minimization formulation applies.
+ *      - All work arrays are flat ([n_members*n_models]) and allocated once by nsga3_init().
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+#include "utlist.h"
+#include "modcell.h"
+
+#define INNER_LAYER_SHRINK 0.5 /* Inner reference points are shrunk towards the simplex centroid by this factor */
+#define ASF_EPS 1.0e-6 	/* Weight of non-target axes in the achievement scalarizing function */
+#define INTERCEPT_TOL 1.0e-10
+
+size_t structured_reference_points(int n_obj, unsigned int max_points, double **points, int *divisions);
+void nsga3_init(MCproblem *mcp);
+void nsga3_free(void);
+void nsga3_select(MCproblem *mcp, Population *combined_pop, Population *parent_pop, item *head_fi, unsigned int fi_size, unsigned int *individuals_added);
+static double n_combinations(int n, int k);
+static void das_dennis(int n_obj, int divisions, double shrink, double *ref, size_t *n_ref_out, int *buff, int obj, int left);
+static int solve_intercepts(int n_obj, double *extreme, double *intercepts);
+
+extern int mpi_pe;
+
+/* Globals */
+static double *ref_points;      /* [n_ref*n_models] */
+static double *ref_norm2;       /* [n_ref] squared norm of each reference direction */
+static size_t n_ref;
+static Individual **members;    /* [2*population_size] selected individuals followed by the last front */
+static double *fnorm;           /* [2*population_size*n_models] normalized objectives of members */
+static double *perp_dist;       /* [2*population_size] */
+static int *assoc;              /* [2*population_size] reference point associated to each member */
+static int *niche_count;        /* [n_ref] */
+static int *is_excluded;        /* [n_ref] */
+static int *is_chosen;          /* [2*population_size] */
+static double *extreme;         /* [n_models*n_models] */
+
+/* Generates structured reference points (or weight vectors) on the unit simplex, returns the number of points
+ *      - The number of divisions is the largest one that does not produce more than max_points. If it is smaller than the number of objectives no interior points exist, so a second (inner) layer is added following the two-layer approach of the NSGA-III paper.
+ *      - divisions: [2] boundary and inner layer divisions (0 if there is no inner layer).
+ *      - points is allocated here ([n_points*n_obj]) and must be freed by the caller.
+ */
+size_t
+structured_reference_points(int n_obj, unsigned int max_points, double **points, int *divisions)
+{
+    int p1, p2 = 0;
+    int *buff;
+    size_t n_points = 0;
+
+    for (p1 = 1; n_combinations(n_obj + p1, p1 + 1) <= max_points; p1++);
+    if (p1 < n_obj)
+        while (n_combinations(n_obj + p1 - 1, p1) + n_combinations(n_obj + p2, p2 + 1) <= max_points)
+            p2++;
+
+    n_points = (size_t)(n_combinations(n_obj + p1 - 1, p1) + (p2 > 0 ? n_combinations(n_obj + p2 - 1, p2) : 0));
+    SAFE_ALLOC(*points = malloc(n_points * n_obj * sizeof **points))
+    SAFE_ALLOC(buff = malloc(n_obj * sizeof *buff))
+
+    n_points = 0;
+    das_dennis(n_obj, p1, 1, *points, &n_points, buff, 0, p1);
+    if (p2 > 0)
+        das_dennis(n_obj, p2, INNER_LAYER_SHRINK, *points, &n_points, buff, 0, p2);
+    free(buff);
+
+    divisions[0] = p1;
+    divisions[1] = p2;
+    return n_points;
+}
+
+/* Generates the reference points and allocates work arrays */
+void
+nsga3_init(MCproblem *mcp)
+{
+    int M = mcp->n_models, divisions[2];
+    size_t max_members = 2*mcp->population_size;
+
+    n_ref = structured_reference_points(M, mcp->population_size, &ref_points, divisions);
+    SAFE_ALLOC(ref_norm2 = malloc(n_ref * sizeof *ref_norm2))
+    for (size_t r=0; r < n_ref; r++) {
+        ref_norm2[r] = 0;
+        for (int k=0; k < M; k++)
+            ref_norm2[r] += ref_points[r*M + k] * ref_points[r*M + k];
+    }
+
+    SAFE_ALLOC(members = malloc(max_members * sizeof *members))
+    SAFE_ALLOC(fnorm = malloc(max_members * M * sizeof *fnorm))
+    SAFE_ALLOC(perp_dist = malloc(max_members * sizeof *perp_dist))
+    SAFE_ALLOC(assoc = malloc(max_members * sizeof *assoc))
+    SAFE_ALLOC(is_chosen = malloc(max_members * sizeof *is_chosen))
+    SAFE_ALLOC(niche_count = malloc(n_ref * sizeof *niche_count))
+    SAFE_ALLOC(is_excluded = malloc(n_ref * sizeof *is_excluded))
+    SAFE_ALLOC(extreme = malloc(M * M * sizeof *extreme))
+
+    if (mcp->verbose && mpi_pe == 0)
+        printf("(PE=0) NSGA-III reference points: %zu (boundary divisions: %d, inner divisions: %d)\n", n_ref, divisions[0], divisions[1]);
+}
+
+void
+nsga3_free(void)
+{
+    free(ref_points);
+    free(ref_norm2);
+    free(members);
+    free(fnorm);
+    free(perp_dist);
+    free(assoc);
+    free(is_chosen);
+    free(niche_count);
+    free(is_excluded);
+    free(extreme);
+}
+
+/* Binomial coefficient as double to avoid overflow for many objectives */
+static double
+n_combinations(int n, int k)
+{
+    double c = 1;
+    for (int i=1; i <= k; i++)
+        c = c * (n - k + i) / i;
+    return c;
+}
+
+/* Recursively enumerates all points of the unit simplex with the given number of divisions (Das and Dennis, 1998). buff holds the partial point in integer units. */
+static void
+das_dennis(int n_obj, int divisions, double shrink, double *ref, size_t *n_ref_out, int *buff, int obj, int left)
+{
+    if (obj == n_obj - 1) {
+        buff[obj] = left;
+        for (int k=0; k < n_obj; k++)
+            ref[(*n_ref_out)*n_obj + k] = (1 - shrink)/n_obj + shrink*(double)buff[k]/divisions;
+        (*n_ref_out)++;
+        return;
+    }
+    for (int i=0; i <= left; i++) {
+        buff[obj] = i;
+        das_dennis(n_obj, divisions, shrink, ref, n_ref_out, buff, obj + 1, left - i);
+    }
+}
+
+/* Solves extreme * x = 1 by Gaussian elimination with partial pivoting, intercepts are 1/x. Returns 0 if the hyperplane is degenerate.  extreme is overwritten. */
+static int
+solve_intercepts(int n_obj, double *extreme, double *intercepts)
+{
+    int i, j, k, piv;
+    double tmp, f;
+    double *b = intercepts;
+
+    for (i=0; i < n_obj; i++)
+        b[i] = 1;
+
+    for (k=0; k < n_obj; k++) {
+        piv = k;
+        for (i=k+1; i < n_obj; i++)
+            if (fabs(extreme[i*n_obj + k]) > fabs(extreme[piv*n_obj + k]))
+                piv = i;
+        if (fabs(extreme[piv*n_obj + k]) < INTERCEPT_TOL)
+            return 0;
+        if (piv != k) {
+            for (j=0; j < n_obj; j++) {
+                tmp = extreme[k*n_obj + j];
+                extreme[k*n_obj + j] = extreme[piv*n_obj + j];
+                extreme[piv*n_obj + j] = tmp;
+            }
+            tmp = b[k]; b[k] = b[piv]; b[piv] = tmp;
+        }
+        for (i=k+1; i < n_obj; i++) {
+            f = extreme[i*n_obj + k]/extreme[k*n_obj + k];
+            for (j=k; j < n_obj; j++)
+                extreme[i*n_obj + j] -= f*extreme[k*n_obj + j];
+            b[i] -= f*b[k];
+        }
+    }
+    for (i=n_obj-1; i >= 0; i--) {
+        for (j=i+1; j < n_obj; j++)
+            b[i] -= extreme[i*n_obj + j]*b[j];
+        b[i] /= extreme[i*n_obj + i];
+    }
+    for (k=0; k < n_obj; k++) {
+        if (!(b[k] > INTERCEPT_TOL)) /* also catches nan */
+            return 0;
+        intercepts[k] = 1/b[k];
+    }
+    return 1;
+}
+
+/* Fills parent_pop with individuals from the last front (head_fi) using reference point niching.
+ *      - The individuals already in parent_pop (fronts 1 to l-1) are used for normalization and niche counts.
+ *      - crowding_distance is not used by NSGA-III, tournament selection reduces to domination with random tie breaking.
+ */
+void
+nsga3_select(MCproblem *mcp, Population *combined_pop, Population *parent_pop, item *head_fi, unsigned int fi_size, unsigned int *individuals_added)
+{
+    int k, l, M = mcp->n_models;
+    size_t i, r, n_sel = *individuals_added, n_members = n_sel + fi_size, best_r, n_ties;
+    double ideal[M], intercepts[M], asf, best_asf, d, dot, min_count;
+    int extreme_idx[M];
+    item *elt;
+
+    assert(n_members <= 2*mcp->population_size);
+
+    /* Gather members, previously selected fronts first */
+    for (i=0; i < n_sel; i++)
+        members[i] = &(parent_pop->indv[i]);
+    i = n_sel;
+    DL_FOREACH(head_fi, elt)
+        members[i++] = &(combined_pop->indv[elt->index]);
+
+    /* Ideal point and translated objectives (minimization form) */
+    for (k=0; k < M; k++) {
+        ideal[k] = -INF;
+        for (i=0; i < n_members; i++)
+            if (members[i]->penalty_objectives[k] > ideal[k])
+                ideal[k] = members[i]->penalty_objectives[k];
+    }
+    for (i=0; i < n_members; i++)
+        for (k=0; k < M; k++)
+            fnorm[i*M + k] = ideal[k] - members[i]->penalty_objectives[k];
+
+    /* Extreme points and hyperplane intercepts */
+    for (k=0; k < M; k++) {
+        best_asf = INF;
+        extreme_idx[k] = 0;
+        for (i=0; i < n_members; i++) {
+            asf = 0;
+            for (l=0; l < M; l++) {
+                d = fnorm[i*M + l] / (l == k ? 1 : ASF_EPS);
+                if (d > asf)
+                    asf = d;
+            }
+            if (asf < best_asf) {
+                best_asf = asf;
+                extreme_idx[k] = i;
+            }
+        }
+        for (l=0; l < M; l++)
+            extreme[k*M + l] = fnorm[extreme_idx[k]*M + l];
+    }
+    if (!solve_intercepts(M, extreme, intercepts)) { /* Degenerate hyperplane, fall back to the nadir of the members */
+        for (k=0; k < M; k++) {
+            intercepts[k] = 0;
+            for (i=0; i < n_members; i++)
+                if (fnorm[i*M + k] > intercepts[k])
+                    intercepts[k] = fnorm[i*M + k];
+            if (intercepts[k] < INTERCEPT_TOL)
+                intercepts[k] = 1;
+        }
+    }
+    for (i=0; i < n_members; i++)
+        for (k=0; k < M; k++)
+            fnorm[i*M + k] /= intercepts[k];
+
+    /* Association to the closest reference line */
+    for (i=0; i < n_members; i++) {
+        perp_dist[i] = INF;
+        assoc[i] = 0;
+        for (r=0; r < n_ref; r++) {
+            dot = 0;
+            for (k=0; k < M; k++)
+                dot += fnorm[i*M + k] * ref_points[r*M + k];
+            dot /= ref_norm2[r];
+            d = 0;
+            for (k=0; k < M; k++)
+                d += (fnorm[i*M + k] - dot*ref_points[r*M + k]) * (fnorm[i*M + k] - dot*ref_points[r*M + k]);
+            if (d < perp_dist[i]) {
+                perp_dist[i] = d;
+                assoc[i] = r;
+            }
+        }
+    }
+
+    /* Niche counts of the already selected individuals */
+    for (r=0; r < n_ref; r++) {
+        niche_count[r] = 0;
+        is_excluded[r] = 0;
+    }
+    for (i=0; i < n_sel; i++)
+        niche_count[assoc[i]]++;
+    for (i=n_sel; i < n_members; i++)
+        is_chosen[i] = 0;
+
+    /* Niching */
+    while (*individuals_added < parent_pop->size) {
+        /* Least crowded reference point, ties broken at random */
+        min_count = INF;
+        n_ties = 0;
+        for (r=0; r < n_ref; r++) {
+            if (is_excluded[r])
+                continue;
+            if (niche_count[r] < min_count) {
+                min_count = niche_count[r];
+                n_ties = 1;
+            } else if (niche_count[r] == min_count)
+                n_ties++;
+        }
+        assert(n_ties > 0);
+        n_ties = pcg32_boundedrand(n_ties);
+        for (best_r=0; best_r < n_ref; best_r++)
+            if (!is_excluded[best_r] && (niche_count[best_r] == min_count) && (n_ties-- == 0))
+                break;
+
+        /* Candidate from the last front */
+        size_t n_cand = 0, chosen = n_members;
+        for (i=n_sel; i < n_members; i++) {
+            if (is_chosen[i] || (assoc[i] != best_r))
+                continue;
+            if (niche_count[best_r] == 0) {
+                if ((chosen == n_members) || (perp_dist[i] < perp_dist[chosen]))
+                    chosen = i;
+            } else { /* reservoir sampling of a random candidate */
+                n_cand++;
+                if (pcg32_boundedrand(n_cand) == 0)
+                    chosen = i;
+            }
+        }
+        if (chosen == n_members) {
+            is_excluded[best_r] = 1;
+            continue;
+        }
+        is_chosen[chosen] = 1;
+        niche_count[best_r]++;
+        copy_individual(mcp, members[chosen], &(parent_pop->indv[*individuals_added]));
+        *(individuals_added) += 1;
+    }
+}
@@ -114,3 +114,8 @@ uint32_t pcg32_boundedrand(uint32_t bound)
     return pcg32_boundedrand_r(&pcg32_global, bound);
 }
 
+
+pcg32_random_t* pcg32_global_state(void)
+{
+    return &pcg32_global;
+}
@@ -71,6 +71,11 @@ uint32_t pcg32_random_r(pcg32_random_t* rng);
 uint32_t pcg32_boundedrand(uint32_t bound);
 uint32_t pcg32_boundedrand_r(pcg32_random_t* rng, uint32_t bound);
 
+// pcg32_global_state()
+//     Address of the state of the global rng (e.g., to save and restore it)
+
+pcg32_random_t* pcg32_global_state(void);
+
 #if __cplusplus
 }
 #endif
@@ -0,0 +1,104 @@
+/* Migration schedule, i.e., when an island initiates a migration.
+ * Notes:
+ *      - Generations: every migration_interval generations. Islands whose models are expensive (or with larger populations) reach that count later, so they send less often than fast islands and the migrations they take part in stay pending longer.
+ *      - Wall-clock: every migration_period seconds (MPI_Wtime()) of the island, so all islands send at the same rate whatever their generation time.
+ *      - Adaptive: as wall-clock, but the period is halved if the island front did not improve between its last two migrations (see topology_stall()) and doubled if it did, within [migration_period/ADAPTIVE_RANGE, migration_period*ADAPTIVE_RANGE]. While the measured migration overhead (wall time spent in migration calls, including polling, over the wall time of the island) is above MAX_MIGRATION_OVERHEAD the period is doubled instead, so slow communication makes islands migrate less often.
+ *      - With the point-to-point transport a migration due while the sends of the previous one are pending is initiated once they complete.
+ */
+
+#include <stdlib.h>
+#include "modcell.h"
+
+#define ADAPTIVE_RANGE 8.0
+#define MAX_MIGRATION_OVERHEAD 0.05 /* Fraction of the wall time */
+
+extern int mpi_pe, mpi_comm_size;
+
+void schedule_init(MCproblem *mcp);
+int schedule_due(MCproblem *mcp, unsigned int n_generations);
+void schedule_record(double seconds);
+void schedule_print(MCproblem *mcp);
+void schedule_checkpoint(FILE *f, int restore);
+
+/* Globals */
+static double time_start, next_time, period;
+static double migration_time; 	/* Wall time spent in migration calls */
+static unsigned int n_migrations;
+
+void
+schedule_init(MCproblem *mcp)
+{
+    if (mcp->migration_schedule > MIGRATION_SCHEDULE_ADAPTIVE) {
+        fprintf(stderr, "error: Invalid migration schedule option\n");
+        exit(-1);
+    }
+    if ((mcp->migration_schedule != MIGRATION_SCHEDULE_GENERATIONS) && (mcp->migration_period <= 0)) {
+        fprintf(stderr, "error: The migration period must be positive.\n");
+        exit(-1);
+    }
+    time_start = MPI_Wtime();
+    period = mcp->migration_period;
+    next_time = time_start + period;
+    migration_time = 0;
+    n_migrations = 0;
+}
+
+/* Returns 1 if a migration should be initiated now, then the next one is scheduled */
+int
+schedule_due(MCproblem *mcp, unsigned int n_generations)
+{
+    double now;
+
+    if (mcp->migration_schedule == MIGRATION_SCHEDULE_GENERATIONS)
+        return n_generations % mcp->migration_interval == 0;
+
+    now = MPI_Wtime();
+    if (now < next_time)
+        return 0;
+    if ((mcp->migration_schedule == MIGRATION_SCHEDULE_ADAPTIVE) && (n_migrations > 0)) {
+        if ((migration_time > MAX_MIGRATION_OVERHEAD * (now - time_start)) || (topology_stall() == 0))
+            period *= 2;
+        else
+            period /= 2;
+        if (period < mcp->migration_period / ADAPTIVE_RANGE)
+            period = mcp->migration_period / ADAPTIVE_RANGE;
+        if (period > mcp->migration_period * ADAPTIVE_RANGE)
+            period = mcp->migration_period * ADAPTIVE_RANGE;
+    }
+    next_time = now + period;
+    n_migrations++;
+    return 1;
+}
+
+/* Adds the wall time of a round of migration calls */
+void
+schedule_record(double seconds)
+{
+    migration_time += seconds;
+}
+
+void
+schedule_print(MCproblem *mcp)
+{
+    if (mcp->migration_schedule == MIGRATION_SCHEDULE_GENERATIONS)
+        return;
+    printf("PE: %i\t Migrations:%u\t Migration period:%.2fs\t Migration overhead:%.2f%%\n", mpi_pe, n_migrations, period,
+            100 * migration_time / (MPI_Wtime() - time_start));
+}
+
+/* Saves or restores the schedule, times are kept relative to the current time (see checkpoint.c) */
+void
+schedule_checkpoint(FILE *f, int restore)
+{
+    double now = MPI_Wtime(), elapsed = now - time_start, wait = next_time - now;
+
+    checkpoint_io(&elapsed, sizeof elapsed, f, restore);
+    checkpoint_io(&wait, sizeof wait, f, restore);
+    checkpoint_io(&period, sizeof period, f, restore);
+    checkpoint_io(&migration_time, sizeof migration_time, f, restore);
+    checkpoint_io(&n_migrations, sizeof n_migrations, f, restore);
+    if (restore) {
+        time_start = now - elapsed;
+        next_time = now + wait;
+    }
+}
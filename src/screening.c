@@ -0,0 +1,141 @@
+/* Two tier (multi-fidelity) evaluation of offspring. Each offspring is first solved with an iteration limit of screening_it_lim simplex iterations. LPs that reach optimality within the limit are already exact, the rest get a provisional objective from their last primal feasible basis. Offspring whose provisional objectives are clearly dominated by a member of the last front of the parent population would not survive environmental selection and are rejected without an exact solve, the others are solved exactly, continuing from their screening basis.
+ * Notes:
+ *      - Provisional objectives are not bounds of the exact ones, so rejection is a heuristic. The margin SCREEN_MARGIN (same as OBJ_TOL) makes it conservative.
+ *      - Rejected offspring get UNKNOWN_OBJ objectives so they are dominated by any evaluated individual. If one is still selected (only possible if there are not enough unique individuals with --remove_duplicates), screening_complete() solves it exactly, so the population always carries exact objectives.
+ */
+
+#include <stdlib.h>
+#include "modcell.h"
+
+#define SCREEN_MARGIN OBJ_TOL
+
+extern glp_smcp param;
+extern int mpi_pe;
+
+void screening_init(MCproblem *mcp);
+void screening_free(void);
+void screen_population(MCproblem *mcp, Population *parent_pop, Population *offspring_pop);
+void screening_complete(MCproblem *mcp, Population *parent_pop);
+void screening_print(MCproblem *mcp);
+static int screen_objectives(MCproblem *mcp, Individual *indv, unsigned char *basis_out);
+static int is_rejected(MCproblem *mcp, Population *parent_pop, Individual *indv);
+
+/* Globals */
+static glp_smcp screen_param;
+static unsigned char *bases; /* [population_size*basis_size] Basis of each offspring after screening */
+static int *change_bound; /* [n_vars] */
+static unsigned int n_screened, n_completed, n_rejected; /* Offspring exact after screening, solved exactly after screening, and rejected, since last print */
+
+void
+screening_init(MCproblem *mcp)
+{
+    screen_param = param;
+    screen_param.it_lim = mcp->screening_it_lim;
+    SAFE_ALLOC(bases = malloc(mcp->population_size * mcp->basis_size * sizeof *bases))
+    SAFE_ALLOC(change_bound = malloc(mcp->n_vars * sizeof *change_bound))
+    n_screened = n_completed = n_rejected = 0;
+}
+
+void
+screening_free(void)
+{
+    free(bases);
+    free(change_bound);
+}
+
+/* Replaces evaluate_population() for the offspring */
+void
+screen_population(MCproblem *mcp, Population *parent_pop, Population *offspring_pop)
+{
+    Individual *indv;
+    int k;
+
+    for (int i=0; i < mcp->population_size; i++) {
+        indv = &(offspring_pop->indv[i]);
+        if (screen_objectives(mcp, indv, &(bases[i*mcp->basis_size]))) {
+            n_screened++;
+        }
+        else if (is_rejected(mcp, parent_pop, indv)) {
+            for (k=0; k < mcp->n_models; k++) {
+                indv->objectives[k] = UNKNOWN_OBJ;
+                indv->penalty_objectives[k] = UNKNOWN_OBJ;
+            }
+            n_rejected++;
+        }
+        else {
+            calculate_objectives_basis(mcp, indv, &(bases[i*mcp->basis_size]), NULL);
+            n_completed++;
+        }
+    }
+}
+
+/* Provisional objectives with the iteration limit, returns 1 if they are exact */
+static int
+screen_objectives(MCproblem *mcp, Individual *indv, unsigned char *basis_out)
+{
+    int k, status, exact = 1;
+
+    if (count_deletions(mcp, indv) == 0) {
+        calculate_objectives_basis(mcp, indv, NULL, basis_out);
+        return 1;
+    }
+
+    for (k=0; k < mcp->n_models; k++) {
+        status = solve_objective(mcp, indv, k, change_bound, &screen_param);
+        save_basis(mcp, k, basis_out);
+        if (status != GLP_OPT)
+            exact = 0;
+        if ((status != GLP_OPT) && (status != GLP_FEAS))
+            indv->objectives[k] = UNKNOWN_OBJ;
+    }
+    set_penalty_objectives(mcp, indv);
+    return exact;
+}
+
+/* An offspring is rejected if a member of the last front of the parent population dominates its provisional objectives by more than SCREEN_MARGIN. Offspring with an unknown provisional objective are never rejected. */
+static int
+is_rejected(MCproblem *mcp, Population *parent_pop, Individual *indv)
+{
+    int i, k, max_rank = 0, dominated;
+    Individual *p;
+
+    for (k=0; k < mcp->n_models; k++)
+        if (indv->objectives[k] == UNKNOWN_OBJ)
+            return 0;
+
+    for (i=0; i < parent_pop->size; i++)
+        if (parent_pop->indv[i].rank > max_rank)
+            max_rank = parent_pop->indv[i].rank;
+
+    for (i=0; i < parent_pop->size; i++) {
+        p = &(parent_pop->indv[i]);
+        if (p->rank != max_rank)
+            continue;
+        dominated = 1;
+        for (k=0; (k < mcp->n_models) && dominated; k++)
+            if (p->penalty_objectives[k] < indv->penalty_objectives[k] + SCREEN_MARGIN)
+                dominated = 0;
+        if (dominated)
+            return 1;
+    }
+    return 0;
+}
+
+/* Solves exactly any rejected offspring that made it into the parent population */
+void
+screening_complete(MCproblem *mcp, Population *parent_pop)
+{
+    for (int i=0; i < parent_pop->size; i++) {
+        if (parent_pop->indv[i].objectives[0] == UNKNOWN_OBJ) {
+            calculate_objectives(mcp, &(parent_pop->indv[i]));
+            n_completed++;
+        }
+    }
+}
+
+void
+screening_print(MCproblem *mcp)
+{
+    printf("PE: %i\t Screening, exact: %u completed: %u rejected: %u\n", mpi_pe, n_screened, n_completed, n_rejected);
+    n_screened = n_completed = n_rejected = 0;
+}
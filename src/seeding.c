@@ -0,0 +1,238 @@
+/* Deletion screening at startup. All single deletions, and the double deletions among the best n_seed_singles of them, are evaluated in all models, the work being split across MPI ranks. The results are used to blacklist reactions whose deletion is lethal and to seed part of the initial population with the best single and double deletions as building blocks.
+ * Notes:
+ *      - A reaction is blacklisted if its deletion makes the LP infeasible in all models. Blacklisted reactions are never deleted by set_random_individual() nor kept deleted by variation (remove_blacklisted()). With modules such a reaction could still be inserted back in some models, this possibility is given up.
+ *      - Blocks are ranked by the sum of their objective increases over the design without deletions, ties (e.g., many single deletions do not couple production) are broken at random.
+ *      - Seeded individuals start from a different block (the best first) and are filled up to alpha deletions with blocks picked by binary tournament. The remaining SEED_RANDOM_FRACTION of the population is random to keep diversity.
+ *      - The cost is n_vars + n_seed_singles*(n_seed_singles - 1)/2 solves per model, divided among the MPI ranks.
+ */
+
+#include <stdlib.h>
+#include "modcell.h"
+
+#define SEED_RANDOM_FRACTION 0.5
+#define MAX_FILL_ATTEMPTS 10
+
+extern glp_smcp param;
+extern int mpi_pe, mpi_comm_size;
+
+typedef struct {
+    int var[2]; /* Deleted reactions, var[1] is -1 for single deletions */
+    double score; /* Sum of the objective increases over no deletions */
+    unsigned int tie; /* Random tie breaker */
+} Block;
+
+void seeding_init(MCproblem *mcp);
+void seeding_free(MCproblem *mcp);
+void set_seeded_population(MCproblem *mcp, Population *pop);
+void remove_blacklisted(MCproblem *mcp, Individual *indv);
+static void evaluate_blocks(MCproblem *mcp, Block *blocks, int n, int *lethal);
+static void add_block(MCproblem *mcp, Individual *indv, Block *block);
+static int compare_blocks(const void *a, const void *b);
+
+/* Globals */
+static Block *pool; /* Blocks that increase the objectives, best first */
+static int pool_size;
+
+void
+seeding_init(MCproblem *mcp)
+{
+    int i, j, k, n_singles = 0, n_doubles = 0, n_blacklisted = 0, n_lethal;
+    int n_top = mcp->n_seed_singles;
+    int *lethal;
+    Block *singles, *doubles;
+    pcg32_random_t rng; /* Same seed in all ranks, so they rank the blocks equally */
+    double time_start = MPI_Wtime();
+
+    SAFE_ALLOC(singles = malloc(mcp->n_vars * sizeof *singles))
+    SAFE_ALLOC(lethal = malloc(mcp->n_vars * mcp->n_models * sizeof *lethal))
+    SAFE_ALLOC(mcp->blacklist = malloc(mcp->n_vars * sizeof *mcp->blacklist))
+
+    /* Single deletions */
+    pcg32_srandom_r(&rng, mcp->seed, 54u);
+    for (j=0; j < mcp->n_vars; j++) {
+        singles[j].var[0] = j;
+        singles[j].var[1] = -1;
+        singles[j].tie = pcg32_random_r(&rng);
+    }
+    evaluate_blocks(mcp, singles, mcp->n_vars, lethal);
+    for (j=0; j < mcp->n_vars; j++) {
+        n_lethal = 0;
+        for (k=0; k < mcp->n_models; k++)
+            n_lethal += lethal[j*mcp->n_models + k];
+        mcp->blacklist[j] = (n_lethal == mcp->n_models);
+        n_blacklisted += mcp->blacklist[j];
+    }
+    if (n_blacklisted == mcp->n_vars) { /* Nothing could be deleted */
+        for (j=0; j < mcp->n_vars; j++)
+            mcp->blacklist[j] = 0;
+        n_blacklisted = 0;
+    }
+
+    /* Rank the non-lethal singles */
+    for (j=0; j < mcp->n_vars; j++)
+        if (!mcp->blacklist[j])
+            singles[n_singles++] = singles[j];
+    qsort(singles, n_singles, sizeof *singles, compare_blocks);
+
+    /* Double deletions among the best singles */
+    if (n_top > n_singles)
+        n_top = n_singles;
+    SAFE_ALLOC(doubles = malloc((n_top*(n_top - 1)/2 + 1) * sizeof *doubles))
+    for (i=0; i < n_top; i++) {
+        for (j=i+1; j < n_top; j++) {
+            doubles[n_doubles].var[0] = singles[i].var[0];
+            doubles[n_doubles].var[1] = singles[j].var[0];
+            doubles[n_doubles].tie = pcg32_random_r(&rng);
+            n_doubles++;
+        }
+    }
+    if (n_doubles > 0) /* Collective, so it does not depend on alpha, which can differ among islands */
+        evaluate_blocks(mcp, doubles, n_doubles, NULL);
+    if (mcp->alpha < 2)
+        n_doubles = 0;
+
+    /* Pool of useful blocks */
+    SAFE_ALLOC(pool = malloc((n_singles + n_doubles + 1) * sizeof *pool))
+    pool_size = 0;
+    for (i=0; i < n_singles; i++)
+        if (singles[i].score > 0)
+            pool[pool_size++] = singles[i];
+    for (i=0; i < n_doubles; i++)
+        if (doubles[i].score > 0)
+            pool[pool_size++] = doubles[i];
+    qsort(pool, pool_size, sizeof *pool, compare_blocks);
+
+    if (mpi_pe == 0)
+        printf("Deletion screening: %zu single and %i double deletions evaluated, %i reactions blacklisted, %i building blocks. Time:%.1fs\n", mcp->n_vars, n_doubles, n_blacklisted, pool_size, MPI_Wtime() - time_start);
+
+    free(singles);
+    free(doubles);
+    free(lethal);
+}
+
+void
+seeding_free(MCproblem *mcp)
+{
+    free(pool);
+    free(mcp->blacklist);
+    mcp->blacklist = NULL;
+}
+
+/* Sets the score of n blocks (and lethal[n*n_models] if not NULL). Each rank solves every mpi_comm_size-th block and the results are shared. */
+static void
+evaluate_blocks(MCproblem *mcp, Block *blocks, int n, int *lethal)
+{
+    int i, v, k, status;
+    double *objectives;
+    int *change_bound;
+    Individual indv;
+
+    SAFE_ALLOC(objectives = calloc(n * mcp->n_models, sizeof *objectives))
+    SAFE_ALLOC(change_bound = malloc(mcp->n_vars * sizeof *change_bound))
+    if (lethal != NULL)
+        for (i=0; i < n * mcp->n_models; i++)
+            lethal[i] = 0;
+    allocate_individual(mcp, &indv);
+    set_blank_individual(mcp, &indv);
+
+    for (i=mpi_pe; i < n; i += mpi_comm_size) {
+        for (v=0; (v < 2) && (blocks[i].var[v] != -1); v++)
+            indv.deletions[blocks[i].var[v]] = DELETED_RXN;
+        for (k=0; k < mcp->n_models; k++) {
+            status = solve_objective(mcp, &indv, k, change_bound, &param);
+            if (status == GLP_OPT)
+                objectives[i*mcp->n_models + k] = indv.objectives[k];
+            if ((lethal != NULL) && (status == GLP_NOFEAS))
+                lethal[i*mcp->n_models + k] = 1;
+        }
+        for (v=0; (v < 2) && (blocks[i].var[v] != -1); v++)
+            indv.deletions[blocks[i].var[v]] = !DELETED_RXN;
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, objectives, n * mcp->n_models, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    if (lethal != NULL)
+        MPI_Allreduce(MPI_IN_PLACE, lethal, n * mcp->n_models, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+    for (i=0; i < n; i++) {
+        blocks[i].score = 0;
+        for (k=0; k < mcp->n_models; k++)
+            blocks[i].score += objectives[i*mcp->n_models + k] - mcp->lps[k].no_deletion_objective;
+    }
+
+    free_individual(mcp, &indv);
+    free(objectives);
+    free(change_bound);
+}
+
+/* Seeds the first individuals of pop from the building blocks and sets the rest at random */
+void
+set_seeded_population(MCproblem *mcp, Population *pop)
+{
+    int i, j, k, b1, b2, attempt, n_deleted, n_seeded = 0;
+    int *deleted_rxns;
+    Individual *indv;
+    Block *block;
+    pcg32_random_t rng;
+    SAFE_ALLOC(deleted_rxns = malloc(mcp->n_vars * sizeof *deleted_rxns))
+
+    if (pool_size > 0)
+        n_seeded = (int)((1 - SEED_RANDOM_FRACTION) * pop->size);
+
+    for (i=0; i < n_seeded; i++) {
+        indv = &(pop->indv[i]);
+        set_rng_stream(mcp, &rng, INIT_RNG_ROUND, i);
+        set_blank_individual(mcp, indv);
+        add_block(mcp, indv, &(pool[i % pool_size]));
+        for (attempt=0; (attempt < MAX_FILL_ATTEMPTS) && (count_deletions(mcp, indv) < mcp->alpha); attempt++) {
+            b1 = pcg32_boundedrand_r(&rng, pool_size);
+            b2 = pcg32_boundedrand_r(&rng, pool_size);
+            block = &(pool[(b1 < b2) ? b1 : b2]); /* The pool is sorted, so the lower index wins */
+            if (count_deletions(mcp, indv) + ((block->var[1] != -1) ? 2 : 1) <= mcp->alpha)
+                add_block(mcp, indv, block);
+        }
+        if (mcp->use_modules) { /* As in set_random_individual() */
+            n_deleted = 0;
+            for (j=0; j < mcp->n_vars; j++)
+                if (indv->deletions[j] == DELETED_RXN)
+                    deleted_rxns[n_deleted++] = j;
+            for (k=0; k < mcp->n_models; k++)
+                indv->modules[k*mcp->n_vars + deleted_rxns[pcg32_boundedrand_r(&rng, n_deleted)]] = MODULE_RXN;
+        }
+        calculate_objectives(mcp, indv);
+    }
+
+    for (i=n_seeded; i < pop->size; i++) {
+        set_rng_stream(mcp, &rng, INIT_RNG_ROUND, i);
+        set_random_individual(mcp, &(pop->indv[i]), &rng);
+    }
+    free(deleted_rxns);
+}
+
+static void
+add_block(MCproblem *mcp, Individual *indv, Block *block)
+{
+    for (int v=0; (v < 2) && (block->var[v] != -1); v++)
+        indv->deletions[block->var[v]] = DELETED_RXN;
+}
+
+/* Reverts the deletion of blacklisted reactions */
+void
+remove_blacklisted(MCproblem *mcp, Individual *indv)
+{
+    for (int j=0; j < mcp->n_vars; j++)
+        if (mcp->blacklist[j])
+            indv->deletions[j] = !DELETED_RXN;
+}
+
+/* Descending score, then random */
+static int
+compare_blocks(const void *a, const void *b)
+{
+    const Block *ba = a, *bb = b;
+
+    if (ba->score != bb->score)
+        return (ba->score < bb->score) ? 1 : -1;
+    if (ba->tie != bb->tie)
+        return (ba->tie < bb->tie) ? 1 : -1;
+    return 0;
+}
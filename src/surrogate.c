@@ -0,0 +1,246 @@
+/* Surrogate pre-screening of offspring. A k-nearest neighbours model over genomes (deletions and modules packed in bitsets, Hamming distance) is trained online with every individual evaluated by the MOEA. Each generation surrogate_factor times more offspring than needed are created, their objectives are predicted, and only the most promising ones are evaluated.
+ * Notes:
+ *      - Candidates are ranked by the number of parents that dominate their predicted penalty objectives, ties are kept in creation (random) order.
+ *      - The training set is a ring buffer of the last SURROGATE_CAPACITY_FACTOR*population_size evaluated individuals. Until it holds SURROGATE_K individuals no filtering is done.
+ *      - Logged accuracy is the mean absolute error of the predicted objectives of evaluated offspring, and the hit rate is the fraction of them that are not dominated by any parent.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "modcell.h"
+
+#define SURROGATE_K 5
+#define SURROGATE_CAPACITY_FACTOR 4
+
+extern int mpi_pe;
+
+void surrogate_init(MCproblem *mcp);
+void surrogate_free(MCproblem *mcp);
+void surrogate_variation(MCproblem *mcp, Population *parent_pop, Population *offspring_pop);
+void surrogate_train(MCproblem *mcp, Population *parent_pop, Population *pop);
+void surrogate_print(MCproblem *mcp);
+static void set_bits(MCproblem *mcp, Individual *indv, uint64_t *bits);
+static void predict(MCproblem *mcp, uint64_t *bits, double *objectives);
+static int dominated_count(MCproblem *mcp, Population *parent_pop, double *objectives);
+static int compare_scores(const void *a, const void *b);
+
+/* Globals */
+static size_t n_words; 		/* Words per genome bitset */
+static size_t capacity, n_train, next_train; /* Training ring buffer */
+static uint64_t *train_bits; 	/* [capacity*n_words] */
+static double *train_objectives; /* [capacity*n_models] */
+static Population candidates; 	/* [surrogate_factor*population_size] */
+static uint64_t *candidate_bits; /* [n_words] */
+static double *predictions; 	/* [surrogate_factor*population_size*n_models] */
+static double *offspring_predictions; /* [population_size*n_models] Predictions of the offspring to be evaluated, UNKNOWN_OBJ if none */
+static int *scores; 		/* [2*surrogate_factor*population_size] (score, candidate) pairs */
+static int *nn_idx; 		/* [SURROGATE_K] */
+static int *nn_dist; 		/* [SURROGATE_K] */
+static double abs_error; 	/* Since last print */
+static unsigned long n_predicted, n_hits;
+
+void
+surrogate_init(MCproblem *mcp)
+{
+    size_t n_bits = mcp->n_vars * (mcp->use_modules ? mcp->n_models + 1 : 1);
+    size_t n_candidates = mcp->surrogate_factor * mcp->population_size;
+
+    n_words = (n_bits + 63)/64;
+    capacity = SURROGATE_CAPACITY_FACTOR * mcp->population_size;
+    n_train = next_train = 0;
+    SAFE_ALLOC(train_bits = calloc(capacity * n_words, sizeof *train_bits))
+    SAFE_ALLOC(train_objectives = malloc(capacity * mcp->n_models * sizeof *train_objectives))
+    allocate_population(mcp, &candidates, n_candidates);
+    set_blank_population(mcp, &candidates);
+    SAFE_ALLOC(candidate_bits = malloc(n_words * sizeof *candidate_bits))
+    SAFE_ALLOC(predictions = malloc(n_candidates * mcp->n_models * sizeof *predictions))
+    SAFE_ALLOC(offspring_predictions = malloc(mcp->population_size * mcp->n_models * sizeof *offspring_predictions))
+    for (size_t i=0; i < mcp->population_size * mcp->n_models; i++)
+        offspring_predictions[i] = UNKNOWN_OBJ;
+    SAFE_ALLOC(scores = malloc(2 * n_candidates * sizeof *scores))
+    SAFE_ALLOC(nn_idx = malloc(SURROGATE_K * sizeof *nn_idx))
+    SAFE_ALLOC(nn_dist = malloc(SURROGATE_K * sizeof *nn_dist))
+    abs_error = 0;
+    n_predicted = n_hits = 0;
+}
+
+void
+surrogate_free(MCproblem *mcp)
+{
+    free(train_bits);
+    free(train_objectives);
+    free_population(mcp, &candidates);
+    free(candidate_bits);
+    free(predictions);
+    free(offspring_predictions);
+    free(scores);
+    free(nn_idx);
+    free(nn_dist);
+}
+
+/* Replaces selection_and_variation(): creates surrogate_factor*population_size candidates and keeps the population_size most promising ones */
+void
+surrogate_variation(MCproblem *mcp, Population *parent_pop, Population *offspring_pop)
+{
+    size_t i, n_candidates = candidates.size;
+    int k, c;
+    Population chunk;
+    Individual *indv;
+
+    chunk.size = mcp->population_size;
+    for (i=0; i < mcp->surrogate_factor; i++) {
+        chunk.indv = &(candidates.indv[i*mcp->population_size]);
+        selection_and_variation(mcp, parent_pop, &chunk);
+    }
+
+    if (n_train < SURROGATE_K) { /* Not enough data, keep the first candidates */
+        for (i=0; i < mcp->population_size; i++) {
+            copy_individual(mcp, &(candidates.indv[i]), &(offspring_pop->indv[i]));
+            for (k=0; k < mcp->n_models; k++)
+                offspring_predictions[i*mcp->n_models + k] = UNKNOWN_OBJ;
+        }
+        return;
+    }
+
+    for (i=0; i < n_candidates; i++) {
+        indv = &(candidates.indv[i]);
+        set_bits(mcp, indv, candidate_bits);
+        predict(mcp, candidate_bits, &(predictions[i*mcp->n_models]));
+        for (k=0; k < mcp->n_models; k++) /* Penalty objectives are compared */
+            indv->objectives[k] = predictions[i*mcp->n_models + k];
+        set_penalty_objectives(mcp, indv);
+        scores[2*i] = dominated_count(mcp, parent_pop, indv->penalty_objectives);
+        scores[2*i + 1] = i;
+    }
+    qsort(scores, n_candidates, 2 * sizeof *scores, compare_scores);
+
+    for (i=0; i < mcp->population_size; i++) {
+        c = scores[2*i + 1];
+        copy_individual(mcp, &(candidates.indv[c]), &(offspring_pop->indv[i]));
+        for (k=0; k < mcp->n_models; k++)
+            offspring_predictions[i*mcp->n_models + k] = predictions[c*mcp->n_models + k];
+    }
+}
+
+/* Adds the evaluated individuals of pop to the training set. If pop holds offspring with predictions, the prediction error and hit rate are recorded. */
+void
+surrogate_train(MCproblem *mcp, Population *parent_pop, Population *pop)
+{
+    size_t i;
+    int k;
+    Individual *indv;
+
+    for (i=0; i < pop->size; i++) {
+        indv = &(pop->indv[i]);
+        if (indv->objectives[0] == UNKNOWN_OBJ) /* Not evaluated (e.g., rejected by screening) */
+            continue;
+        if ((parent_pop != NULL) && (offspring_predictions[i*mcp->n_models] != UNKNOWN_OBJ)) {
+            for (k=0; k < mcp->n_models; k++)
+                abs_error += fabs(offspring_predictions[i*mcp->n_models + k] - indv->objectives[k]);
+            n_predicted++;
+            if (dominated_count(mcp, parent_pop, indv->penalty_objectives) == 0)
+                n_hits++;
+        }
+        set_bits(mcp, indv, &(train_bits[next_train*n_words]));
+        for (k=0; k < mcp->n_models; k++)
+            train_objectives[next_train*mcp->n_models + k] = indv->objectives[k];
+        next_train = (next_train + 1) % capacity;
+        if (n_train < capacity)
+            n_train++;
+    }
+}
+
+void
+surrogate_print(MCproblem *mcp)
+{
+    if (n_predicted > 0)
+        printf("PE: %i\t Surrogate, mean absolute error: %.4f hit rate: %.2f\n", mpi_pe, abs_error/(n_predicted*mcp->n_models), (double)n_hits/n_predicted);
+    abs_error = 0;
+    n_predicted = n_hits = 0;
+}
+
+static void
+set_bits(MCproblem *mcp, Individual *indv, uint64_t *bits)
+{
+    size_t j, b = 0;
+
+    for (j=0; j < n_words; j++)
+        bits[j] = 0;
+    for (j=0; j < mcp->n_vars; j++, b++)
+        if (indv->deletions[j] == DELETED_RXN)
+            bits[b/64] |= (uint64_t)1 << (b % 64);
+    if (mcp->use_modules)
+        for (j=0; j < mcp->n_models * mcp->n_vars; j++, b++)
+            if (indv->modules[j] == MODULE_RXN)
+                bits[b/64] |= (uint64_t)1 << (b % 64);
+}
+
+/* Inverse distance weighted mean of the objectives of the SURROGATE_K nearest training individuals */
+static void
+predict(MCproblem *mcp, uint64_t *bits, double *objectives)
+{
+    size_t i, w;
+    int k, n = 0, d, pos;
+    double weight, total = 0;
+
+    for (i=0; i < n_train; i++) {
+        d = 0;
+        for (w=0; w < n_words; w++)
+            d += __builtin_popcountll(bits[w] ^ train_bits[i*n_words + w]);
+        if ((n == SURROGATE_K) && (d >= nn_dist[n-1]))
+            continue;
+        if (n < SURROGATE_K)
+            n++;
+        for (pos = n-1; (pos > 0) && (nn_dist[pos-1] > d); pos--) { /* Insertion into the sorted neighbour list */
+            nn_dist[pos] = nn_dist[pos-1];
+            nn_idx[pos] = nn_idx[pos-1];
+        }
+        nn_dist[pos] = d;
+        nn_idx[pos] = i;
+    }
+
+    for (k=0; k < mcp->n_models; k++)
+        objectives[k] = 0;
+    for (i=0; i < n; i++) {
+        weight = 1.0/(1 + nn_dist[i]);
+        total += weight;
+        for (k=0; k < mcp->n_models; k++)
+            objectives[k] += weight * train_objectives[nn_idx[i]*mcp->n_models + k];
+    }
+    for (k=0; k < mcp->n_models; k++)
+        objectives[k] /= total;
+}
+
+static int
+dominated_count(MCproblem *mcp, Population *parent_pop, double *objectives)
+{
+    int i, k, count = 0, dominates, strictly;
+    double *p;
+
+    for (i=0; i < parent_pop->size; i++) {
+        p = parent_pop->indv[i].penalty_objectives;
+        dominates = 1;
+        strictly = 0;
+        for (k=0; (k < mcp->n_models) && dominates; k++) {
+            if (p[k] < objectives[k])
+                dominates = 0;
+            if (p[k] > objectives[k])
+                strictly = 1;
+        }
+        if (dominates && strictly)
+            count++;
+    }
+    return count;
+}
+
+/* Ascending score, then candidate index */
+static int
+compare_scores(const void *a, const void *b)
+{
+    const int *sa = a, *sb = b;
+
+    if (sa[0] != sb[0])
+        return sa[0] - sb[0];
+    return sa[1] - sb[1];
+}
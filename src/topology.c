@@ -0,0 +1,210 @@
+/* Migration topologies, i.e., the islands (PEs) each island sends migrants to. The neighbours of static topologies are computed once at startup and each migration goes to the next one in turn.
+ * Notes:
+ *      - Ring: the next island. Hypercube: the islands whose index differs in one bit (those above mpi_comm_size are left out), one dimension per migration. Torus: the four neighbours in a 2-D grid as square as mpi_comm_size allows. Small-world: the ring plus SMALL_WORLD_SHORTCUTS random long range links. Broadcast: all islands at every migration, each receives migration_size/(mpi_comm_size - 1) elites from every other island.
+ *      - Random and adaptive topologies pick one island other than itself at each migration. Adaptive picks island p with weight 1 + its stall, the number of consecutive migrations of p without improvement of its best value for any objective, as last reported in a message from p. So migrants are routed toward islands whose fronts have stalled.
+ *      - Only broadcast has a fan out above one, islands then keep up to that many messages per generation.
+ */
+
+#include <stdlib.h>
+#include "modcell.h"
+
+#define SMALL_WORLD_SHORTCUTS 2
+#define STALL_TOLERANCE 1e-6
+
+extern int mpi_pe, mpi_comm_size;
+
+void topology_init(MCproblem *mcp);
+void topology_free(void);
+int topology_fan_out(MCproblem *mcp);
+int topology_targets(MCproblem *mcp, Population *parent_population, int *targets);
+int topology_stall(void);
+void topology_observe(int source_pe, int stall);
+void topology_checkpoint(MCproblem *mcp, FILE *f, int restore);
+static void add_neighbour(int pe);
+static void update_stall(MCproblem *mcp, Population *parent_population);
+
+/* Globals */
+static int *neighbours; 	/* [mpi_comm_size] Static topologies */
+static int n_neighbours;
+static unsigned int n_migrations;
+static int *peer_stall; 	/* [mpi_comm_size] Last stall reported by each island */
+static int own_stall;
+static double *best_objectives; /* [n_models] */
+
+void
+topology_init(MCproblem *mcp)
+{
+    int d, i, rows, cols, row, col, fan_out;
+    pcg32_random_t rng; /* Shortcuts of this island */
+
+    SAFE_ALLOC(neighbours = malloc(mpi_comm_size * sizeof *neighbours))
+    SAFE_ALLOC(peer_stall = calloc(mpi_comm_size, sizeof *peer_stall))
+    SAFE_ALLOC(best_objectives = malloc(mcp->n_models * sizeof *best_objectives))
+    for (i=0; i < mcp->n_models; i++)
+        best_objectives[i] = -INF;
+    n_neighbours = 0;
+    n_migrations = 0;
+    own_stall = 0;
+
+    switch (mcp->migration_topology) {
+    case MIGRATION_TOPOLOGY_RING:
+        add_neighbour((mpi_pe + 1) % mpi_comm_size);
+        break;
+    case MIGRATION_TOPOLOGY_HYPERCUBE:
+        for (d=0; (1 << d) < mpi_comm_size; d++)
+            if ((mpi_pe ^ (1 << d)) < mpi_comm_size)
+                add_neighbour(mpi_pe ^ (1 << d));
+        break;
+    case MIGRATION_TOPOLOGY_TORUS:
+        for (rows=1, i=1; i*i <= mpi_comm_size; i++)
+            if (mpi_comm_size % i == 0)
+                rows = i;
+        cols = mpi_comm_size / rows;
+        row = mpi_pe / cols;
+        col = mpi_pe % cols;
+        add_neighbour(row*cols + (col + 1) % cols);
+        add_neighbour(((row + 1) % rows)*cols + col);
+        add_neighbour(row*cols + (col + cols - 1) % cols);
+        add_neighbour(((row + rows - 1) % rows)*cols + col);
+        break;
+    case MIGRATION_TOPOLOGY_SMALL_WORLD:
+        add_neighbour((mpi_pe + 1) % mpi_comm_size);
+        pcg32_srandom_r(&rng, mcp->seed + mpi_pe, 56u);
+        for (i=0; i < SMALL_WORLD_SHORTCUTS; i++)
+            add_neighbour((int)pcg32_boundedrand_r(&rng, mpi_comm_size));
+        break;
+    case MIGRATION_TOPOLOGY_BROADCAST:
+        for (i=1; i < mpi_comm_size; i++)
+            add_neighbour((mpi_pe + i) % mpi_comm_size);
+        break;
+    case MIGRATION_TOPOLOGY_RANDOM:
+    case MIGRATION_TOPOLOGY_ADAPTIVE:
+        break;
+    default:
+        fprintf (stderr, "error: Invalid migration topology option\n");
+        exit(-1);
+    }
+
+    /* Migration size is split evenly among the islands reached by one migration */
+    fan_out = topology_fan_out(mcp);
+    if (mcp->migration_size % fan_out != 0) {
+        mcp->migration_size = fan_out * ((mcp->migration_size > fan_out) ? mcp->migration_size / fan_out : 1);
+        if (mpi_pe == 0) printf("Migration size set to %u, a multiple of the %i islands reached by each migration\n", mcp->migration_size, fan_out);
+    }
+    if (mcp->migration_size > mcp->population_size) {
+        fprintf(stderr, "error: The migration size (%u) is above the population size (%u) of island %i.\n", mcp->migration_size, mcp->population_size, mpi_pe);
+        exit(-1);
+    }
+}
+
+void
+topology_free(void)
+{
+    free(neighbours);
+    free(peer_stall);
+    free(best_objectives);
+}
+
+/* Adds pe to the neighbours unless it is the island itself or already a neighbour */
+static void
+add_neighbour(int pe)
+{
+    if (pe == mpi_pe)
+        return;
+    for (int i=0; i < n_neighbours; i++)
+        if (neighbours[i] == pe)
+            return;
+    neighbours[n_neighbours++] = pe;
+}
+
+/* Number of islands each migration is sent to */
+int
+topology_fan_out(MCproblem *mcp)
+{
+    if (mcp->migration_topology == MIGRATION_TOPOLOGY_BROADCAST)
+        return mpi_comm_size - 1;
+    return 1;
+}
+
+/* Sets the targets of the next migration, returns their number */
+int
+topology_targets(MCproblem *mcp, Population *parent_population, int *targets)
+{
+    int i, pe;
+    unsigned int total = 0, r;
+
+    update_stall(mcp, parent_population);
+    switch (mcp->migration_topology) {
+    case MIGRATION_TOPOLOGY_BROADCAST:
+        for (i=0; i < n_neighbours; i++)
+            targets[i] = neighbours[i];
+        n_migrations++;
+        return n_neighbours;
+    case MIGRATION_TOPOLOGY_RANDOM:
+        pe = (int)pcg32_boundedrand(mpi_comm_size - 1);
+        targets[0] = (pe >= mpi_pe) ? pe + 1 : pe;
+        break;
+    case MIGRATION_TOPOLOGY_ADAPTIVE:
+        for (pe=0; pe < mpi_comm_size; pe++)
+            if (pe != mpi_pe)
+                total += 1 + peer_stall[pe];
+        r = pcg32_boundedrand(total);
+        for (pe=0; pe < mpi_comm_size; pe++) {
+            if (pe == mpi_pe)
+                continue;
+            if (r < 1 + peer_stall[pe])
+                break;
+            r -= 1 + peer_stall[pe];
+        }
+        targets[0] = pe;
+        break;
+    default:
+        targets[0] = neighbours[n_migrations % n_neighbours];
+    }
+    n_migrations++;
+    return 1;
+}
+
+/* Counts the consecutive migrations in which no best objective value of the island improved */
+static void
+update_stall(MCproblem *mcp, Population *parent_population)
+{
+    int i, k, improved = 0;
+    double best;
+
+    for (k=0; k < mcp->n_models; k++) {
+        best = -INF;
+        for (i=0; i < parent_population->size; i++)
+            if (parent_population->indv[i].objectives[k] > best)
+                best = parent_population->indv[i].objectives[k];
+        if (best > best_objectives[k] + STALL_TOLERANCE) {
+            best_objectives[k] = best;
+            improved = 1;
+        }
+    }
+    own_stall = improved ? 0 : own_stall + 1;
+}
+
+int
+topology_stall(void)
+{
+    return own_stall;
+}
+
+/* Records the stall reported by another island */
+void
+topology_observe(int source_pe, int stall)
+{
+    if ((source_pe >= 0) && (source_pe < mpi_comm_size))
+        peer_stall[source_pe] = stall;
+}
+
+/* Saves or restores the migration counter and the stall of this and the other islands (see checkpoint.c) */
+void
+topology_checkpoint(MCproblem *mcp, FILE *f, int restore)
+{
+    checkpoint_io(&n_migrations, sizeof n_migrations, f, restore);
+    checkpoint_io(&own_stall, sizeof own_stall, f, restore);
+    checkpoint_io(peer_stall, mpi_comm_size * sizeof *peer_stall, f, restore);
+    checkpoint_io(best_objectives, mcp->n_models * sizeof *best_objectives, f, restore);
+}